@@ -18,6 +18,18 @@
 #include <ecs_cpp/context.hpp>
 #include <ecs_cpp/group.hpp>
 #include <ecs_cpp/matcher.hpp>
+#include <ecs_cpp/trace.hpp>
+#include <ecs_cpp/serialization.hpp>
+#include <ecs_cpp/snapshot.hpp>
+#include <ecs_cpp/replication.hpp>
+#include <ecs_cpp/journal.hpp>
+#include <ecs_cpp/static_world.hpp>
+#include <ecs_cpp/entity_index.hpp>
+#include <ecs_cpp/sorted_group.hpp>
+#include <ecs_cpp/spatial_grid.hpp>
+#include <ecs_cpp/reserve_hints.hpp>
+#include <ecs_cpp/frame_allocator.hpp>
+#include <ecs_cpp/read_snapshot.hpp>
 
 namespace ecs_cpp
 {
@@ -5,6 +5,10 @@
  *
  * the component only has data, has no function
  *
+ * a component can be any plain struct, deriving from ecs_cpp::component is optional,
+ * it only adds the back pointer to the entity(and a vtable) for component::sibling,
+ * a plain struct component reaches its siblings through the entity or a component_handle
+ *
  * @author  :   yandaren1220@126.com
  * @date    :   2017-08-19
  */
@@ -46,6 +50,53 @@ C*      component::sibling()
     return nullptr;
 }
 
+/**
+ * @brief the component with its owning entity, no back pointer is stored in the component
+ */
+template<typename C>
+class component_handle
+{
+protected:
+    entity*     entity_;
+    C*          comp_;
+
+public:
+    component_handle()
+        : entity_(nullptr), comp_(nullptr){}
+
+    component_handle(entity* en)
+        : entity_(en), comp_(en ? en->get_component<C>() : nullptr){}
+
+public:
+    C*      get() const{
+        return comp_;
+    }
+
+    C*      operator->() const{
+        return comp_;
+    }
+
+    C&      operator*() const{
+        return *comp_;
+    }
+
+    explicit operator bool() const{
+        return comp_ != nullptr;
+    }
+
+    entity* owner() const{
+        return entity_;
+    }
+
+    template<typename S>
+    S*      sibling() const{
+        if (entity_){
+            return entity_->get_component<S>();
+        }
+        return nullptr;
+    }
+};
+
 }
 
 #endif
\ No newline at end of file
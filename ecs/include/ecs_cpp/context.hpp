@@ -13,17 +13,242 @@
 #define __ydk_ecs_context_hpp__
 
 #include <ecs_cpp/entity_manager.hpp>
+#include <ecs_cpp/frame_allocator.hpp>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdexcept>
 
 namespace ecs_cpp{
 
+namespace detail
+{
+    inline uint32_t next_unique_type_index(){
+        static std::atomic<uint32_t> counter(0);
+        return counter++;
+    }
+
+    /** the process wide index of an unique component type, assigned at the first use */
+    template<typename C>
+    struct unique_type_index
+    {
+        static uint32_t value(){
+            static const uint32_t index = next_unique_type_index();
+            return index;
+        }
+    };
+}
+
 class context
 {
 public:
     entity_manager entity_admin;
 
+protected:
+    struct unique_slot_t{
+        void*       value;
+        void        (*deleter)(void*);
+        uint64_t    version;        // the context unique version when it was last changed
+    };
+
+    /** the per tick scratch memory of the systems */
+    frame_allocator             frame_;
+
+    /** <unique type index, the unique component> */
+    std::vector<unique_slot_t>  unique_slots_;
+    uint64_t                    unique_version_;
+
+public:
+    /**
+     * @param resource - the memory resource of the entitys, the components and the containers,
+     * it must outlive the context, the global heap if null
+     */
+    explicit context(utility::memory_resource* resource = nullptr)
+        : entity_admin(resource)
+        , frame_(64 * 1024, resource)
+        , unique_version_(0)
+    {
+    }
+    virtual ~context(){
+        for (auto& slot : unique_slots_){
+            if (slot.value){
+                slot.deleter(slot.value);
+            }
+        }
+    }
+
+    context(const context&) = delete;
+    context& operator = (const context&) = delete;
+
+public:
+    /**
+     * @brief the per tick scratch memory, rewound after each update by the system_manager constructed with
+     * the context(or given it by system_manager::set_frame_allocator)
+     */
+    frame_allocator& frame(){
+        return frame_;
+    }
+
+    /**
+     * @brief transient storage of n T from the arena of the calling thread, no malloc in the steady state
+     * valid until the end of the update pass, see frame_allocator::alloc
+     * throw if no system_manager rewinds the frame memory, it would grow without bound
+     */
+    template<typename T>
+    T*  frame_alloc(std::size_t n){
+        if (!frame_.managed()){
+            throw std::logic_error("frame alloc failed, no system_manager rewinds the frame memory of the context");
+        }
+        return frame_.alloc<T>(n);
+    }
+
+    /**
+     * @brief reserve the memory of the entitys before the first tick
+     */
+    void reserve(uint32_t entity_count){
+        entity_admin.reserve(entity_count);
+    }
+
+    /**
+     * @brief reserve the cells of the component pool before the first tick
+     */
+    template<typename C>
+    void reserve(uint32_t count){
+        entity_admin.reserve<C>(count);
+    }
+
+    /**
+     * @brief save the high-water marks of this run, load them at the next startup
+     */
+    bool save_reserve_hints(const std::string& path){
+        return entity_admin.collect_reserve_hints().save(path);
+    }
+
+    /**
+     * @brief reserve by the hints of the previous run, false if there are no hints
+     */
+    bool load_reserve_hints(const std::string& path){
+        reserve_hints hints;
+        if (!hints.load(path)){
+            return false;
+        }
+        entity_admin.apply_reserve_hints(hints);
+        return true;
+    }
+
 public:
-    context(){}
-    virtual ~context(){}
+    /**
+     * @brief the world level unique component(time, input, config...), default constructed at the first access
+     * the write through the reference is not detected, use set_unique/patch_unique/mark_unique_changed
+     */
+    template<typename C>
+    C&  unique(){
+        unique_slot_t& slot = unique_slot<C>();
+        if (!slot.value){
+            set_unique<C>();
+        }
+        return *static_cast<C*>(slot.value);
+    }
+
+    /**
+     * @brief get the unique component, nullptr if not set
+     */
+    template<typename C>
+    C*  find_unique(){
+        uint32_t index = detail::unique_type_index<C>::value();
+        return index < unique_slots_.size() ? static_cast<C*>(unique_slots_[index].value) : nullptr;
+    }
+
+    template<typename C>
+    bool has_unique(){
+        return find_unique<C>() != nullptr;
+    }
+
+    /**
+     * @brief create or replace the unique component, marked changed
+     * constructed with () when it has a matching constructor and with {} otherwise, like the entity components
+     */
+    template<typename C, typename... Args>
+    C&  set_unique(Args&& ...args){
+        typedef std::integral_constant<bool, std::is_constructible<C, Args...>::value> use_constructor;
+        unique_slot_t& slot = unique_slot<C>();
+        if (slot.value){
+            *static_cast<C*>(slot.value) = detail::make_component<C>(use_constructor(), std::forward<Args>(args)...);
+        }
+        else{
+            slot.value = detail::new_component<C>(use_constructor(), std::forward<Args>(args)...);
+            slot.deleter = &delete_unique<C>;
+        }
+        slot.version = ++unique_version_;
+        return *static_cast<C*>(slot.value);
+    }
+
+    /**
+     * @brief modify the unique component in place and mark it changed
+     */
+    template<typename C, typename F>
+    C&  patch_unique(F f){
+        C& value = unique<C>();
+        f(value);
+        mark_unique_changed<C>();
+        return value;
+    }
+
+    template<typename C>
+    void mark_unique_changed(){
+        unique_slot_t& slot = unique_slot<C>();
+        if (slot.value){
+            slot.version = ++unique_version_;
+        }
+    }
+
+    template<typename C>
+    void remove_unique(){
+        unique_slot_t& slot = unique_slot<C>();
+        if (slot.value){
+            slot.deleter(slot.value);
+            slot.value = nullptr;
+            slot.version = ++unique_version_;
+        }
+    }
+
+    /**
+     * @brief the version when the unique component was last set/changed/removed, 0 if never
+     * a system keeps the version it has seen, and check unique_changed_since(seen) each tick
+     */
+    template<typename C>
+    uint64_t unique_version(){
+        uint32_t index = detail::unique_type_index<C>::value();
+        return index < unique_slots_.size() ? unique_slots_[index].version : 0;
+    }
+
+    template<typename C>
+    bool unique_changed_since(uint64_t seen_version){
+        return unique_version<C>() > seen_version;
+    }
+
+    /**
+     * @brief the latest version of all the unique components
+     */
+    uint64_t unique_version() const{
+        return unique_version_;
+    }
+
+protected:
+    template<typename C>
+    unique_slot_t& unique_slot(){
+        uint32_t index = detail::unique_type_index<C>::value();
+        if (index >= unique_slots_.size()){
+            unique_slot_t empty_slot = { nullptr, nullptr, 0 };
+            unique_slots_.resize(index + 1, empty_slot);
+        }
+        return unique_slots_[index];
+    }
+
+    template<typename C>
+    static void delete_unique(void* value){
+        delete static_cast<C*>(value);
+    }
 };
 }
 
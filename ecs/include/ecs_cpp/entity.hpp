@@ -17,36 +17,97 @@
 #include <stdexcept>
 #include <typeindex>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 
 namespace ecs_cpp{
 typedef std::vector<component_id> component_type_list;
 
 class component;
+namespace detail{
+    template<typename C> struct column_codec;
+    template<typename C> struct custom_codec;
+    template<typename C> struct tag_codec;
+
+    /** construct with (), or with {} for the aggregates(plain structs) */
+    template<typename C, typename... Args>
+    C* construct_component(void* mem, std::true_type, Args&& ...args){
+        return new (mem) C(std::forward<Args>(args)...);
+    }
+
+    template<typename C, typename... Args>
+    C* construct_component(void* mem, std::false_type, Args&& ...args){
+        return new (mem) C{ std::forward<Args>(args)... };
+    }
+
+    /** the same ()/{} dispatch for the heap allocated and the temporary values */
+    template<typename C, typename... Args>
+    C* new_component(std::true_type, Args&& ...args){
+        return new C(std::forward<Args>(args)...);
+    }
+
+    template<typename C, typename... Args>
+    C* new_component(std::false_type, Args&& ...args){
+        return new C{ std::forward<Args>(args)... };
+    }
+
+    template<typename C, typename... Args>
+    C make_component(std::true_type, Args&& ...args){
+        return C(std::forward<Args>(args)...);
+    }
+
+    template<typename C, typename... Args>
+    C make_component(std::false_type, Args&& ...args){
+        return C{ std::forward<Args>(args)... };
+    }
+}
+
 class entity
 {
 public:
     friend class entity_manager;
+    friend class snapshot;
+    template<typename C> friend struct detail::column_codec;
+    template<typename C> friend struct detail::custom_codec;
+    template<typename C> friend struct detail::tag_codec;
 
 protected:
 
     struct component_info_t{
-        component* comp;
-        int32_t    component_size;
+        void*       comp;
+        int32_t     component_size;
+        uint32_t    bit;            // the signature bit
+        bool        shared;         // references an interned value of the shared store
     };
 
+    typedef std::unordered_map<component_id, component_info_t, std::hash<component_id>, std::equal_to<component_id>,
+        utility::resource_allocator<std::pair<const component_id, component_info_t>>> component_map_type;
+
     int64_t                 entity_id_;
-    std::unordered_map<component_id, component_info_t> components_map_;
+    component_map_type      components_map_;
     entity_manager_iface*   entity_mgr_;
 
+    /* the components(and tags) the entity has, the tags are stored only here */
+    component_signature     signature_;
+    uint32_t                tag_count_;
+
+    /* set by the entity manager when the entity is being destoryed */
+    bool                    destorying_;
+
+    /* a disabled entity keeps its components, but is skipped by the groups and the queries */
+    bool                    enabled_;
+
     /* <entity, new added component>*/
-    event_publisher<entity*, component*> component_added_event_publisher_;
+    event_publisher<entity*, void*> component_added_event_publisher_;
 
     /* <entity, old component, new component> */
-    event_publisher<entity*, component*, component*> component_replaced_event_publisher_;
+    event_publisher<entity*, void*, void*> component_replaced_event_publisher_;
 
     /* <entity, removed component */
-    event_publisher<entity*, component*> component_removed_event_publisher_;
+    event_publisher<entity*, void*> component_removed_event_publisher_;
+
+    /* <entity, changed component>, the component is modified in place */
+    event_publisher<entity*, void*> component_changed_event_publisher_;
 
 public:
     entity() = delete;
@@ -55,7 +116,11 @@ public:
 
     entity(int64_t id, entity_manager_iface* mgr)
         : entity_id_(id)
+        , components_map_(0, std::hash<component_id>(), std::equal_to<component_id>(), mgr ? mgr->resource() : nullptr)
         , entity_mgr_(mgr)
+        , tag_count_(0)
+        , destorying_(false)
+        , enabled_(true)
     {
     }
 
@@ -94,11 +159,34 @@ public:
     }
 
     uint32_t component_count(){
-        return components_map_.size();
+        return components_map_.size() + tag_count_;
+    }
+
+    const component_signature& signature() const{
+        return signature_;
+    }
+
+    bool enabled() const{
+        return enabled_;
+    }
+
+    /**
+     * @brief enable/disable the entity without structural changes, a disabled entity stays in its groups
+     * but is skipped by the group iteration and the queries, the components and the events are kept
+     */
+    void set_enabled(bool enabled){
+        if (enabled_ == enabled){
+            return;
+        }
+
+        enabled_ = enabled;
+        if (entity_mgr_){
+            entity_mgr_->notify_entity_enabled(this, enabled);
+        }
     }
 
     /** sub/unsub component added event */
-    void    subscribe_component_added_event(event_subscriber<entity*, component*>* sub, int32_t mode){
+    void    subscribe_component_added_event(event_subscriber<entity*, void*>* sub, int32_t mode){
         if (mode == 1){
             component_added_event_publisher_.subscribe(sub);
         }
@@ -108,7 +196,7 @@ public:
     }
 
     /** sub/unsub component replace event */
-    void    subscribe_component_replace_event(event_subscriber<entity*, component*, component*>* sub, int32_t mode){
+    void    subscribe_component_replace_event(event_subscriber<entity*, void*, void*>* sub, int32_t mode){
         if (mode == 1){
             component_replaced_event_publisher_.subscribe(sub);
         }
@@ -118,7 +206,7 @@ public:
     }
 
     /** sub/unsub component remove event */
-    void    subscribe_component_remove_event(event_subscriber<entity*, component*>* sub, int32_t mode){
+    void    subscribe_component_remove_event(event_subscriber<entity*, void*>* sub, int32_t mode){
         if (mode == 1){
             component_removed_event_publisher_.subscribe(sub);
         }
@@ -127,20 +215,134 @@ public:
         }
     }
 
+    /** sub/unsub component changed event */
+    void    subscribe_component_change_event(event_subscriber<entity*, void*>* sub, int32_t mode){
+        if (mode == 1){
+            component_changed_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            component_changed_event_publisher_.unsubscribe(sub);
+        }
+    }
+
     template<typename C, typename... Args>
     entity& add_component(Args&& ...args){
         if (has_component<C>()){
             throw std::runtime_error("add component to entity failed, the component already exists");
         }
 
-        component* comp = add_component_no_check<C>(std::forward<Args>(args)...);
+        void* comp = add_component_no_check<C>(std::forward<Args>(args)...);
 
         // fire the component added event
         component_added_event_publisher_.publish_event(this, comp);
+        if (entity_mgr_){
+            entity_mgr_->notify_component_added(this, typeid(C).hash_code(), comp);
+        }
 
         return *this;
     }
 
+    /**
+     * @brief add a shared component, the entity references the interned value equal to value
+     * the value is shared by the entitys, don't modify it through get_component, replace it instead
+     */
+    template<typename C>
+    entity& add_shared_component(const C& value){
+        if (has_component<C>()){
+            throw std::runtime_error("add shared component to entity failed, the component already exists");
+        }
+
+        void* comp = add_shared_component_no_check<C>(value);
+
+        // fire the component added event
+        component_added_event_publisher_.publish_event(this, comp);
+        if (entity_mgr_){
+            entity_mgr_->notify_component_added(this, typeid(C).hash_code(), comp);
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief add or replace with a shared component
+     */
+    template<typename C>
+    entity& replace_shared_component(const C& value){
+        uint32_t type_id = typeid(C).hash_code();
+        auto iter = components_map_.find(type_id);
+        if (iter == components_map_.end()){
+            return add_shared_component<C>(value);
+        }
+
+        component_info_t old_info = iter->second;
+        void* new_component = add_shared_component_no_check<C>(value);
+
+        // fire component replace event
+        component_replaced_event_publisher_.publish_event(this, old_info.comp, new_component);
+        if (entity_mgr_){
+            entity_mgr_->notify_component_replaced(this, type_id, old_info.comp, new_component);
+        }
+
+        // the same interned value is referenced only once
+        if (new_component != old_info.comp){
+            release_component(type_id, old_info);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief whether the component references a shared value
+     */
+    template<typename C>
+    bool    is_shared_component(){
+        auto iter = components_map_.find(typeid(C).hash_code());
+        return iter != components_map_.end() && iter->second.shared;
+    }
+
+    /**
+     * @brief modify the component in place with f(C&), then fire the component changed event
+     * no allocation and the component address is unchanged, unlike replace_component
+     * a shared component is copied, modified and re-interned, the other entitys keep the old value
+     */
+    template<typename C, typename F>
+    entity& patch_component(F f){
+        static_assert(!is_tag_component<C>::value, "the tag component has no value to patch");
+
+        uint32_t type_id = typeid(C).hash_code();
+        auto iter = components_map_.find(type_id);
+        if (iter == components_map_.end()){
+            throw std::runtime_error("patch component of entity failed, the component doesn't exist");
+        }
+
+        if (iter->second.shared){
+            C value = *static_cast<C*>(iter->second.comp);
+            f(value);
+            return replace_shared_component<C>(value);
+        }
+
+        f(*static_cast<C*>(iter->second.comp));
+        notify_component_changed(type_id, iter->second.comp);
+        return *this;
+    }
+
+    /**
+     * @brief fire the component changed event after the component is written through get_component
+     * do nothing if the entity doesn't have the component
+     * throw for a shared component, the interned value must not be written in place(use patch_component)
+     */
+    template<typename C>
+    entity& mark_changed(){
+        uint32_t type_id = typeid(C).hash_code();
+        auto iter = components_map_.find(type_id);
+        if (iter != components_map_.end()){
+            if (iter->second.shared){
+                throw std::runtime_error("mark component changed failed, the shared component is changed by patch_component");
+            }
+            notify_component_changed(type_id, iter->second.comp);
+        }
+        return *this;
+    }
+
     template<typename C>
     entity& remove_component(){
         uint32_t type_id = typeid(C).hash_code();
@@ -150,6 +352,11 @@ public:
 
     template<typename C, typename... Args>
     entity& replace_component(Args&& ...args){
+        if (is_tag_component<C>::value && has_component<C>()){
+            // a tag has no value to replace
+            return *this;
+        }
+
         if (has_component<C>()){
             replace_component_no_check<C>(std::forward<Args>(args)...);
         }
@@ -162,24 +369,43 @@ public:
 
     template<typename C>
     bool    has_component(){
+        uint32_t bit = component_type_registry::bit<C>();
+        if (bit != invalid_component_bit){
+            return signature_.test(bit);
+        }
         uint32_t type_id = typeid(C).hash_code();
         return components_map_.find(type_id) != components_map_.end();
     }
 
+    /**
+     * @brief whether the entity has the component(or tag) by the component type id
+     */
+    bool    has_component(component_id id) const{
+        if (components_map_.find(id) != components_map_.end()){
+            return true;
+        }
+        return tag_count_ > 0 && has_tag(id);
+    }
+
+    /**
+     * @brief whether the entity has all the components, a mask test when all the types have a bit
+     */
     template<typename... Components>
     bool    has_components(){
-        std::vector<std::function<bool()>> funs = { std::bind(&entity::has_component<Components>, this)... };
-        for (auto& f : funs){
-            if (!f()){
-                return false;
-            }
+        const component_type_registry::mask_t& m = component_type_registry::mask<Components...>();
+        if (m.complete){
+            return (signature_ & m.mask) == m.mask;
         }
-        return true;
+
+        bool result = true;
+        int dummy[] = { 0, (result = result && has_component<Components>(), 0)... };
+        (void)dummy;
+        return result;
     }
 
     bool has_components(const component_type_list& list) const{
         for (auto type_id : list){
-            if (components_map_.find(type_id) == components_map_.end()){
+            if (!has_component(type_id)){
                 return false;
             }
         }
@@ -188,7 +414,7 @@ public:
 
     bool has_any_components(const component_type_list& list) const{
         for (auto type_id : list){
-            if (components_map_.find(type_id) != components_map_.end()){
+            if (has_component(type_id)){
                 return true;
             }
         }
@@ -197,19 +423,28 @@ public:
 
     bool has_none_components(const component_type_list& list) const{
         for (auto type_id : list){
-            if (components_map_.find(type_id) != components_map_.end()){
+            if (has_component(type_id)){
                 return false;
             }
         }
         return true;
     }
 
+    /**
+     * @brief get the component, for a tag it's a shared empty instance if the entity has the tag
+     */
     template<typename C>
     C*      get_component(){
-        uint32_t type_id = typeid(C).hash_code();
-        auto iter = components_map_.find(type_id);
+        return get_component<C>(is_tag_component<C>());
+    }
+
+    /**
+     * @brief get the component by the component type id
+     */
+    void* get_component(component_id id){
+        auto iter = components_map_.find(id);
         if (iter != components_map_.end()){
-            return static_cast<C*>(iter->second.comp);
+            return iter->second.comp;
         }
         return nullptr;
     }
@@ -219,52 +454,212 @@ public:
         return std::make_tuple(get_component<Components>()...);
     }
 
+    /**
+     * @brief visit all the components, f(component_id, void*)
+     * the visitor must not add/remove the components of the entity
+     */
+    template<typename F>
+    void for_each_component(F f){
+        // the tags have no storage, they are the bits left after the bits of the stored components
+        component_signature tags = signature_;
+        for (auto& comp_kv : components_map_){
+            if (comp_kv.second.bit != invalid_component_bit){
+                tags.reset(comp_kv.second.bit);
+            }
+            f(comp_kv.first, comp_kv.second.comp);
+        }
+
+        if (tag_count_ > 0){
+            component_type_registry& registry = component_type_registry::instance();
+            uint32_t visited = 0;
+            for (uint32_t bit = 0; bit < tags.size() && visited < tag_count_; ++bit){
+                if (tags.test(bit)){
+                    f(registry.id_of_bit(bit), nullptr);
+                    ++visited;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief remove the component by the component type id
+     */
+    void remove_component(component_id id){
+        auto iter = components_map_.find(id);
+        if (iter == components_map_.end()){
+            remove_tag(id);
+            return;
+        }
+
+        component_info_t info = iter->second;
+        if (info.bit != invalid_component_bit){
+            signature_.reset(info.bit);
+        }
+
+        components_map_.erase(iter);
+
+        // fire the component remove event
+        component_removed_event_publisher_.publish_event(this, info.comp);
+        if (entity_mgr_ && !destorying_){
+            entity_mgr_->notify_component_removed(this, id, info.comp);
+        }
+
+        release_component(id, info);
+    }
+
 protected:
 
     template<typename C, typename... Args>
-    component* add_component_no_check(Args&& ...args){
+    void* add_component_no_check(Args&& ...args){
+        return emplace_component<C>(is_tag_component<C>(), std::forward<Args>(args)...);
+    }
+
+    template<typename C, typename... Args>
+    void* emplace_component(std::false_type /* not tag */, Args&& ...args){
         uint32_t type_id = typeid(C).hash_code();
         memory_pool_type* pool = check_or_create_component_pool<C>();
-        component* comp = new (pool->allocate())C(std::forward<Args>(args)...);
-        comp->set_entity(this);
+        C* comp = detail::construct_component<C>(pool->allocate(),
+            std::integral_constant<bool, std::is_constructible<C, Args...>::value>(), std::forward<Args>(args)...);
+        attach_component(comp, std::integral_constant<bool, std::is_base_of<component, C>::value>());
         component_info_t& comp_info = components_map_[type_id];
         comp_info.comp = comp;
         comp_info.component_size = sizeof(C);
+        comp_info.bit = component_type_registry::bit<C>();
+        comp_info.shared = false;
+        if (comp_info.bit != invalid_component_bit){
+            signature_.set(comp_info.bit);
+        }
         return comp;
     }
 
+    template<typename C>
+    void* add_shared_component_no_check(const C& value){
+        static_assert(!is_tag_component<C>::value, "the tag component has no value to share");
+        static_assert(!std::is_base_of<component, C>::value, "the shared component has no owner entity, use a plain struct");
+
+        C* comp = entity_mgr_->check_or_create_shared_store<C>()->acquire(value, this);
+        component_info_t& comp_info = components_map_[typeid(C).hash_code()];
+        comp_info.comp = comp;
+        comp_info.component_size = sizeof(C);
+        comp_info.bit = component_type_registry::bit<C>();
+        comp_info.shared = true;
+        if (comp_info.bit != invalid_component_bit){
+            signature_.set(comp_info.bit);
+        }
+        return comp;
+    }
+
+    /**
+     * @brief free the components without events(entity_manager::clear), the shared values are
+     * freed with their stores, the pools destruct only the non trivially destructible types
+     */
+    void    drop_components(){
+        for (auto& comp_kv : components_map_){
+            if (!comp_kv.second.shared){
+                get_component_pool(comp_kv.first)->reclaim(comp_kv.second.comp);
+            }
+        }
+        components_map_.clear();
+        signature_.reset();
+        tag_count_ = 0;
+    }
+
+    /** free the component memory, or drop the reference to the shared value */
+    void    release_component(component_id id, const component_info_t& info){
+        if (info.shared){
+            entity_mgr_->get_shared_store(id)->release(info.comp, this);
+        }
+        else{
+            memory_pool_type* pool = get_component_pool(id);
+            pool->reclaim(info.comp);
+        }
+    }
+
+    void    notify_component_changed(component_id id, void* comp){
+        component_changed_event_publisher_.publish_event(this, comp);
+        if (entity_mgr_){
+            entity_mgr_->notify_component_changed(this, id, comp);
+        }
+    }
+
+    /** a tag is only a signature bit, no allocation */
+    template<typename C, typename... Args>
+    void* emplace_component(std::true_type /* tag */, Args&& ...args){
+        uint32_t bit = component_type_registry::bit<C>();
+        if (!signature_.test(bit)){
+            signature_.set(bit);
+            ++tag_count_;
+        }
+        return nullptr;
+    }
+
+    template<typename C>
+    C*      get_component(std::false_type /* not tag */){
+        uint32_t type_id = typeid(C).hash_code();
+        auto iter = components_map_.find(type_id);
+        if (iter != components_map_.end()){
+            return static_cast<C*>(iter->second.comp);
+        }
+        return nullptr;
+    }
+
+    template<typename C>
+    C*      get_component(std::true_type /* tag */){
+        static C tag_instance;
+        return signature_.test(component_type_registry::bit<C>()) ? &tag_instance : nullptr;
+    }
+
+    bool    has_tag(component_id id) const{
+        component_type_registry::type_info_t info;
+        return component_type_registry::instance().find(id, info) && info.tag && signature_.test(info.bit);
+    }
+
+    void    remove_tag(component_id id){
+        component_type_registry::type_info_t info;
+        if (tag_count_ == 0 || !component_type_registry::instance().find(id, info) || !info.tag || !signature_.test(info.bit)){
+            return;
+        }
+
+        signature_.reset(info.bit);
+        --tag_count_;
+
+        // fire the component remove event
+        component_removed_event_publisher_.publish_event(this, nullptr);
+        if (entity_mgr_ && !destorying_){
+            entity_mgr_->notify_component_removed(this, id, nullptr);
+        }
+    }
+
     template<typename C, typename... Args>
     entity& replace_component_no_check(Args&& ...args){
         uint32_t type_id = typeid(C).hash_code();
         auto iter = components_map_.find(type_id);
         if (iter != components_map_.end()){
-            component* old_component = iter->second.comp;
-            component* new_component = add_component_no_check<C>(std::forward<Args>(args)...);
+            component_info_t old_info = iter->second;
+            void* new_component = add_component_no_check<C>(std::forward<Args>(args)...);
 
             // fire component replace event
-            component_replaced_event_publisher_.publish_event(this, old_component, new_component);
+            component_replaced_event_publisher_.publish_event(this, old_info.comp, new_component);
+            if (entity_mgr_){
+                entity_mgr_->notify_component_replaced(this, type_id, old_info.comp, new_component);
+            }
 
             // delete the old component
-            memory_pool_type* pool = check_or_create_component_pool<C>();
-            pool->reclaim(old_component);
+            release_component(type_id, old_info);
         }
         return *this;
     }
 
-    void remove_component(component_id id){
-        auto iter = components_map_.find(id);
-        if (iter != components_map_.end()){
-            component* comp = iter->second.comp;
-            int32_t component_size = iter->second.component_size;
-
-            components_map_.erase(iter);
-
-            // fire the component remove event
-            component_removed_event_publisher_.publish_event(this, comp);
+    /** the components derived from ecs_cpp::component know their entity */
+    template<typename C>
+    void attach_component(C* comp, std::true_type){
+        // dependent on C, resolved when the component class is complete
+        comp->set_entity(this);
+    }
 
-            memory_pool_type* pool = get_component_pool(id);
-            pool->reclaim(comp);
-        }
+    /** the plain struct components have no back pointer, use the entity handle */
+    template<typename C>
+    void attach_component(C* /*comp*/, std::false_type){
     }
 
 private:
@@ -0,0 +1,295 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: entity_index.hpp
+ *
+ * the secondary entity indices keyed by a component field value, kept in sync by the
+ * manager level component events, the lookups are hashed
+ *
+ *  entity_unique_index<player, int64_t> by_player_id(ctx.entity_admin, [](const player& p){ return p.player_id; });
+ *  entity* en = by_player_id.find(10086);
+ *
+ *  entity_index<team, int32_t> by_team(ctx.entity_admin, [](const team& t){ return t.team_id; });
+ *  const entity_set* ens = by_team.find(2);
+ *
+ * the component written in place must be marked changed(entity::mark_changed, or reindex) to be reindexed,
+ * and the indices must be rebuilt after a bulk load that fires no events(snapshot::load)
+ */
+
+#ifndef __ydk_ecs_entity_index_hpp__
+#define __ydk_ecs_entity_index_hpp__
+
+#include <ecs_cpp/entity_manager.hpp>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ecs_cpp
+{
+template<typename C, typename Key, typename Hash = std::hash<Key>>
+class entity_index_base
+{
+public:
+    typedef std::function<Key(const C&)> key_getter;
+
+protected:
+    entity_manager&     entity_mgr_;
+    key_getter          key_getter_;
+    component_id        component_id_;
+
+    /** <entity, the indexed key>, to find the old key after the component is changed in place */
+    std::unordered_map<entity*, Key> keys_;
+
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+public:
+    entity_index_base(entity_manager& entity_mgr, key_getter getter)
+        : entity_mgr_(entity_mgr)
+        , key_getter_(getter)
+        , component_id_((component_id)typeid(C).hash_code())
+    {
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&entity_index_base::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&entity_index_base::event_cleared, this));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&entity_index_base::event_component_added, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&entity_index_base::event_component_replaced, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&entity_index_base::event_component_removed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&entity_index_base::event_component_changed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+        subscribe_events(1);
+    }
+
+    virtual ~entity_index_base(){
+        subscribe_events(0);
+    }
+
+    entity_index_base(const entity_index_base&) = delete;
+    entity_index_base& operator = (const entity_index_base&) = delete;
+
+public:
+    /**
+     * @brief reindex the entity after its component is written in place without entity::mark_changed
+     */
+    void reindex(entity* en){
+        C* comp = en->get_component<C>();
+        if (comp){
+            index_entity(en, key_getter_(*comp));
+        }
+        else{
+            unindex_entity(en);
+        }
+    }
+
+    /**
+     * @brief index all the entitys again
+     */
+    void rebuild(){
+        clear_keys();
+        keys_.clear();
+        entity_mgr_.for_each_entity([this](entity* en){
+            C* comp = en->get_component<C>();
+            if (comp){
+                index_entity(en, key_getter_(*comp));
+            }
+        });
+    }
+
+    /**
+     * @brief the count of the indexed entitys
+     */
+    uint32_t entity_count() const{
+        return keys_.size();
+    }
+
+protected:
+    virtual void insert_key(entity* en, const Key& key) = 0;
+    virtual void erase_key(entity* en, const Key& key) = 0;
+    virtual void clear_keys() = 0;
+
+    void index_entity(entity* en, const Key& key){
+        auto iter = keys_.find(en);
+        if (iter != keys_.end()){
+            if (iter->second == key){
+                return;
+            }
+            erase_key(en, iter->second);
+            iter->second = key;
+        }
+        else{
+            keys_.insert(std::make_pair(en, key));
+        }
+        insert_key(en, key);
+    }
+
+    void unindex_entity(entity* en){
+        auto iter = keys_.find(en);
+        if (iter != keys_.end()){
+            erase_key(en, iter->second);
+            keys_.erase(iter);
+        }
+    }
+
+    void subscribe_events(int32_t mode){
+        entity_mgr_.subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+        entity_mgr_.subscribe_clear_event(&cleared_subscriber_, mode);
+        entity_mgr_.subscribe_component_added_event(&component_added_subscriber_, mode);
+        entity_mgr_.subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+        entity_mgr_.subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        entity_mgr_.subscribe_component_change_event(&component_changed_subscriber_, mode);
+    }
+
+    void event_entity_removed(entity* en){
+        unindex_entity(en);
+    }
+
+    void event_cleared(){
+        clear_keys();
+        keys_.clear();
+    }
+
+    void event_component_added(entity* en, component_id id, void* comp){
+        if (id == component_id_){
+            index_entity(en, key_getter_(*static_cast<const C*>(comp)));
+        }
+    }
+
+    void event_component_replaced(entity* en, component_id id, void* /*old_comp*/, void* new_comp){
+        if (id == component_id_){
+            index_entity(en, key_getter_(*static_cast<const C*>(new_comp)));
+        }
+    }
+
+    void event_component_removed(entity* en, component_id id, void* /*comp*/){
+        if (id == component_id_){
+            unindex_entity(en);
+        }
+    }
+
+    void event_component_changed(entity* en, component_id id, void* comp){
+        if (id == component_id_){
+            index_entity(en, key_getter_(*static_cast<const C*>(comp)));
+        }
+    }
+};
+
+/**
+ * @brief the multi-valued index, all the entitys whose key is the value
+ */
+template<typename C, typename Key, typename Hash = std::hash<Key>>
+class entity_index : public entity_index_base<C, Key, Hash>
+{
+protected:
+    std::unordered_map<Key, entity_set, Hash> entitys_;
+
+public:
+    entity_index(entity_manager& entity_mgr, typename entity_index_base<C, Key, Hash>::key_getter getter)
+        : entity_index_base<C, Key, Hash>(entity_mgr, getter)
+    {
+        this->rebuild();
+    }
+
+public:
+    /**
+     * @brief the entitys of the key, nullptr if none
+     */
+    const entity_set* find(const Key& key) const{
+        auto iter = entitys_.find(key);
+        if (iter != entitys_.end()){
+            return &iter->second;
+        }
+        return nullptr;
+    }
+
+    uint32_t count(const Key& key) const{
+        const entity_set* ens = find(key);
+        return ens ? ens->size() : 0;
+    }
+
+protected:
+    virtual void insert_key(entity* en, const Key& key) override{
+        entitys_[key].insert(en);
+    }
+
+    virtual void erase_key(entity* en, const Key& key) override{
+        auto iter = entitys_.find(key);
+        if (iter != entitys_.end()){
+            iter->second.erase(en);
+            if (iter->second.empty()){
+                entitys_.erase(iter);
+            }
+        }
+    }
+
+    virtual void clear_keys() override{
+        entitys_.clear();
+    }
+};
+
+/**
+ * @brief the unique index, the entity whose key is the value
+ * a duplicated key is kept(so removing one entity doesn't lose the other), see count()
+ */
+template<typename C, typename Key, typename Hash = std::hash<Key>>
+class entity_unique_index : public entity_index_base<C, Key, Hash>
+{
+protected:
+    std::unordered_multimap<Key, entity*, Hash> entitys_;
+
+public:
+    entity_unique_index(entity_manager& entity_mgr, typename entity_index_base<C, Key, Hash>::key_getter getter)
+        : entity_index_base<C, Key, Hash>(entity_mgr, getter)
+    {
+        this->rebuild();
+    }
+
+public:
+    /**
+     * @brief the entity of the key, nullptr if none
+     */
+    entity* find(const Key& key) const{
+        auto iter = entitys_.find(key);
+        if (iter != entitys_.end()){
+            return iter->second;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief the entity count of the key, more than 1 means the key is duplicated
+     */
+    uint32_t count(const Key& key) const{
+        return entitys_.count(key);
+    }
+
+protected:
+    virtual void insert_key(entity* en, const Key& key) override{
+        entitys_.insert(std::make_pair(key, en));
+    }
+
+    virtual void erase_key(entity* en, const Key& key) override{
+        auto range = entitys_.equal_range(key);
+        for (auto iter = range.first; iter != range.second; ++iter){
+            if (iter->second == en){
+                entitys_.erase(iter);
+                return;
+            }
+        }
+    }
+
+    virtual void clear_keys() override{
+        entitys_.clear();
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -14,22 +14,55 @@
 #include <ecs_cpp/group.hpp>
 #include <ecs_cpp/matcher.hpp>
 #include <ecs_cpp/entity_manager_iface.hpp>
+#include <atomic>
+#include <algorithm>
+#include <vector>
 
 namespace ecs_cpp
 {
+namespace detail
+{
+    inline uint32_t next_group_slot(){
+        static std::atomic<uint32_t> counter(0);
+        return counter++;
+    }
+
+    /** the process wide slot of a type-level matcher, assigned at the first use */
+    template<typename... Parts>
+    struct group_slot
+    {
+        static uint32_t value(){
+            static const uint32_t slot = next_group_slot();
+            return slot;
+        }
+    };
+}
+
 class entity_manager : public entity_manager_iface
 {
+public:
+    friend class snapshot;
+    friend class journal_replayer;
+
 protected:
-    std::unordered_map<int64_t, entity*> entity_map_;
+    std::unordered_map<int64_t, entity*, std::hash<int64_t>, std::equal_to<int64_t>,
+        utility::resource_allocator<std::pair<const int64_t, entity*>>> entity_map_;
     int64_t                              next_entity_id_;
 
     typedef uint32_t matcher_hash_type;
-    typedef std::unordered_map<matcher_hash_type, group*> mather_group_map_type;
+    typedef std::unordered_multimap<matcher_hash_type, group*> mather_group_map_type;
     mather_group_map_type                mather_group_map_;
 
+    /** <type-level matcher slot, group> */
+    std::vector<group*>                  typed_groups_;
+
+    /** the groups of the incremental population that are not ready yet */
+    std::vector<group*>                  warming_groups_;
+
     /** event publisher */
     event_publisher<entity*>             entity_create_event_publisher_;
     event_publisher<entity*>             entity_remove_event_publisher_;
+    event_publisher<>                    clear_event_publisher_;
 
     /** entity pool */
     utility::memory_pool_ex<entity, utility::sync::null_mutex> entity_memory_pool_;
@@ -61,6 +94,18 @@ public:
         }
     }
 
+    /**
+    * @brief sub/unsubscribe the clear event, fired once by clear() instead of the entity remove events
+    */
+    virtual void subscribe_clear_event(event_subscriber<>* sub, int32_t mode) override{
+        if (mode == 1){
+            clear_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            clear_event_publisher_.unsubscribe(sub);
+        }
+    }
+
     /**
     * @brief create the entity
     */
@@ -83,6 +128,10 @@ public:
 
         // fire the en destory event
         entity_remove_event_publisher_.publish_event(en);
+        en->destorying_ = true;
+        en->for_each_component([this, en](component_id id, void*){
+            unindex_component(en, id);
+        });
 
         // remove from the map
         entity_map_.erase(en->id());
@@ -91,19 +140,45 @@ public:
         entity_memory_pool_.reclaim(en);
     }
 
+    /**
+    * @brief match the entitys that are not matched yet of the lazy/warming group
+    */
+    virtual void populate_group(group* gp) override{
+        if (!gp || gp->ready_){
+            return;
+        }
+
+        if (gp->pending_ids_.empty()){
+            for (auto& en_kv : entity_map_){
+                gp->handle_entity_match(en_kv.second);
+            }
+        }
+        else{
+            warm_group(gp, gp->pending_ids_.size());
+        }
+        set_group_ready(gp);
+    }
+
 public:
-    entity_manager() : next_entity_id_(0), entity_memory_pool_(1){}
+    /**
+     * @param resource - see entity_manager_iface, the groups and the entitys allocate from it too
+     */
+    explicit entity_manager(utility::memory_resource* resource = nullptr)
+        : entity_manager_iface(resource)
+        , entity_map_(0, std::hash<int64_t>(), std::equal_to<int64_t>(), resource_)
+        , next_entity_id_(0)
+        , entity_memory_pool_(0, 1, resource_)
+    {
+        entity_memory_pool_.set_grow_policy(pool_grow_policy_, pool_grow_count_);
+    }
     virtual ~entity_manager(){
+        // the bulk teardown, the subscribers get the clear event instead of the entity/component remove events
+        clear();
+
         for (auto& gp_kv : mather_group_map_){
             delete gp_kv.second;
             gp_kv.second = nullptr;
         }
-
-        // remove all entitys
-        while (!entity_map_.empty()){
-            entity* en = entity_map_.begin()->second;
-            en->destory();
-        }
     }
 
 public:
@@ -124,34 +199,440 @@ public:
         return entity_map_.size();
     }
 
-    group* get_group(matcher::ptr mther){
-        group* gp = nullptr;
-        if (!mther){
-            return nullptr;
+    virtual void set_pool_grow_policy(utility::pool_grow_policy policy, uint32_t grow_cell_count) override{
+        entity_manager_iface::set_pool_grow_policy(policy, grow_cell_count);
+        entity_memory_pool_.set_grow_policy(policy, grow_cell_count);
+    }
+
+    /**
+     * @brief reserve the memory of the entitys before the first tick
+     */
+    void reserve(uint32_t entity_count){
+        entity_memory_pool_.reserve(entity_count);
+        entity_map_.reserve(entity_count);
+    }
+
+    /**
+     * @brief reserve the cells of the component pool
+     */
+    template<typename C>
+    void reserve(uint32_t count){
+        check_or_create_component_pool<C>()->reserve(count);
+    }
+
+    /**
+     * @brief the high-water marks of the pools of this run, see reserve_hints
+     */
+    reserve_hints collect_reserve_hints(){
+        reserve_hints hints;
+        hints.entity_count = entity_memory_pool_.high_water();
+        for (auto& cp_pool_kv : component_pool_map_){
+            hints.component_counts[cp_pool_kv.first] = cp_pool_kv.second->high_water();
         }
+        return hints;
+    }
 
-        matcher_hash_type mather_hash_code = mther->hash_code();
-        auto iter = mather_group_map_.find(mather_hash_code);
-        if (iter == mather_group_map_.end()){
-            // new create a group
-            gp = new group(mther, this);
-            for (auto& en_kv : entity_map_){
-                gp->handle_entity_match(en_kv.second);
+    /**
+     * @brief reserve by the hints, the pools that are not created yet are reserved at the creation
+     */
+    void apply_reserve_hints(const reserve_hints& hints){
+        reserve(hints.entity_count);
+        for (auto& count_kv : hints.component_counts){
+            pool_reserve_counts_[count_kv.first] = count_kv.second;
+            memory_pool_type* pool = get_component_pool(count_kv.first);
+            if (pool){
+                pool->reserve(count_kv.second);
             }
-            mather_group_map_.insert(std::make_pair(mather_hash_code, gp));
+        }
+    }
 
-            // todo, fire group create event
+    /**
+     * @brief destory all the entitys in bulk, for the world reset
+     * no entity/component event is fired, only the clear event. the groups are kept(empty and ready),
+     * the pools keep their memory for the reuse, and the entity ids keep increasing.
+     * the journal/trace recorders record it as one clear record
+     */
+    void clear(){
+        for (auto& en_kv : entity_map_){
+            entity* en = en_kv.second;
+            en->drop_components();
+            entity_memory_pool_.reclaim(en);
         }
-        else{
-            gp = iter->second;
+        entity_map_.clear();
+        clear_component_index();
+
+        for (auto& gp_kv : mather_group_map_){
+            gp_kv.second->clear_entities();
+            set_group_ready(gp_kv.second);
+        }
+
+        clear_event_publisher_.publish_event();
+    }
+
+    /**
+     * @brief visit all the entitys, the visitor must not create/destory entitys
+     */
+    template<typename F>
+    void for_each_entity(F f){
+        for (auto& en_kv : entity_map_){
+            f(en_kv.second);
+        }
+    }
+
+    /**
+     * @brief get the group of the matcher, the group is pinned: kept for the lifetime of the manager
+     * even if it's also acquired, use acquire_group/release_group for the groups of a limited lifetime
+     * the groups got at the startup(before any entity is created) cost nothing to populate,
+     * they are built as the entitys arrive
+     * @param mode - how the existing entitys are matched when the group is created, see group_population
+     */
+    group* get_group(matcher::ptr mther, group_population mode = group_populate_eager){
+        group* gp = check_or_create_group(mther, mode);
+        if (gp){
+            gp->pin();
+        }
+        return gp;
+    }
+
+    /**
+     * @brief get the group of the matcher and add a reference, release it by release_group
+     * when it's no longer used(unless it's also got by get_group)
+     */
+    group* acquire_group(matcher::ptr mther, group_population mode = group_populate_eager){
+        group* gp = check_or_create_group(mther, mode);
+        if (gp){
+            gp->retain();
+        }
+        return gp;
+    }
+
+    /**
+     * @brief drop a reference of the group, the group stops receiving the events and is
+     * deleted with the last reference
+     */
+    void release_group(group* gp){
+        if (!gp || gp->release() > 0 || gp->pinned()){
+            return;
         }
+
+        auto range = mather_group_map_.equal_range(gp->matcher()->hash_code());
+        for (auto iter = range.first; iter != range.second; ++iter){
+            if (iter->second == gp){
+                mather_group_map_.erase(iter);
+                break;
+            }
+        }
+        set_group_ready(gp);
+        delete gp;
+    }
+
+    /**
+     * @brief match up to budget entitys for the groups of the incremental population, call it once per tick
+     * @return true if all the groups are ready
+     */
+    bool warm_groups(std::size_t budget){
+        while (budget > 0 && !warming_groups_.empty()){
+            group* gp = warming_groups_.front();
+            budget -= warm_group(gp, budget);
+            if (gp->pending_pos_ >= gp->pending_ids_.size()){
+                set_group_ready(gp);
+            }
+        }
+        return warming_groups_.empty();
+    }
+
+    uint32_t group_count(){
+        return mather_group_map_.size();
+    }
+
+    /**
+     * @brief visit the entitys that have all of the components without registering a group,
+     * f(entity*, Components*...), see query(matcher, f)
+     */
+    template<typename... Components, typename F>
+    void query(F f){
+        static const matcher::ptr mther = matcher::of<all_of<Components...>>();
+        query(mther, [&f](entity* en){
+            f(en, en->get_component<Components>()...);
+        });
+    }
+
+    /**
+     * @brief get the group of the type-level matcher, get_group<all_of<A, B>, none_of<C>>()
+     * resolved through a static slot of the matcher type, no matcher is built after the first call
+     */
+    template<typename... Parts>
+    group* get_group(group_population mode = group_populate_eager){
+        uint32_t slot = detail::group_slot<Parts...>::value();
+        if (slot < typed_groups_.size() && typed_groups_[slot]){
+            return typed_groups_[slot];
+        }
+
+        group* gp = get_group(matcher::of<Parts...>(), mode);
+        if (slot >= typed_groups_.size()){
+            typed_groups_.resize(slot + 1, nullptr);
+        }
+        typed_groups_[slot] = gp;
         return gp;
     }
 
+    /**
+     * @brief get the group of the composite matcher, get_group(all_of<A, B>().none_of<C>())
+     */
+    template<typename... Parts>
+    group* get_group(matcher_expr<Parts...>, group_population mode = group_populate_eager){
+        return get_group<Parts...>(mode);
+    }
+
+    /**
+     * @brief acquire the group of the type-level matcher, release it by release_group
+     * the typed slot only caches the pinned groups, so the acquired group is found through the matcher
+     */
+    template<typename... Parts>
+    group* acquire_group(group_population mode = group_populate_eager){
+        return acquire_group(matcher::of<Parts...>(), mode);
+    }
+
+    template<typename... Parts>
+    group* acquire_group(matcher_expr<Parts...>, group_population mode = group_populate_eager){
+        return acquire_group<Parts...>(mode);
+    }
+
+    /**
+     * @brief get the existing group of the matcher, nullptr if not created
+     */
+    group* find_group(const matcher& mther){
+        // the hash may collide, compare the full matcher
+        auto range = mather_group_map_.equal_range(mther.hash_code());
+        for (auto iter = range.first; iter != range.second; ++iter){
+            if (*iter->second->matcher() == mther){
+                return iter->second;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief visit the enabled entitys matched by the matcher without creating a group, f(entity*)
+     * the planner drives the iteration from the smallest candidate set(an existing group that covers
+     * the matcher, or the entitys of an all-of/any-of component), and tests the rest by the signature.
+     * the visitor must not add/remove the components of the matcher or create/destory entitys
+     */
+    template<typename F>
+    void query(const matcher::ptr& mther, F f){
+        if (!mther){
+            return;
+        }
+
+        const entity_set* driver = nullptr;
+        bool exact = false;
+        std::size_t driver_size = entity_map_.size() + 1;
+        for (auto& gp_kv : mather_group_map_){
+            group* gp = gp_kv.second;
+            if (gp->ready() && gp->matcher()->covers(*mther) && gp->members().size() < driver_size){
+                driver = &gp->members();
+                driver_size = driver->size();
+                exact = (*gp->matcher() == *mther);
+            }
+        }
+
+        for (component_id id : mther->all_of_component_types()){
+            const entity_set* ens = component_entitys(id);
+            std::size_t size = ens ? ens->size() : 0;
+            if (size < driver_size){
+                driver = ens;
+                driver_size = size;
+                exact = false;
+            }
+        }
+
+        if (driver_size == 0){
+            return;
+        }
+
+        if (driver){
+            for (entity* en : *driver){
+                if (en->enabled() && (exact || mther->matches(en))){
+                    f(en);
+                }
+            }
+            return;
+        }
+
+        // only any-of/none-of
+        const component_type_list& any_list = mther->any_of_component_types();
+        if (!any_list.empty()){
+            query_any_of(*mther, any_list, f);
+            return;
+        }
+
+        for (auto& en_kv : entity_map_){
+            if (en_kv.second->enabled() && mther->matches(en_kv.second)){
+                f(en_kv.second);
+            }
+        }
+    }
+
+    /**
+     * @brief query with the composite matcher, query(all_of<A>().none_of<B>(), f)
+     */
+    template<typename... Parts, typename F>
+    void query(matcher_expr<Parts...>, F f){
+        static const matcher::ptr mther = matcher::of<Parts...>();
+        query(mther, f);
+    }
+
+    /**
+     * @brief rematch all the entitys against all the groups in one pass, and rebuild the component index,
+     * used after the entitys are bulk loaded without events
+     */
+    void rebuild_groups(){
+        component_entitys_.clear();
+        for (auto& en_kv : entity_map_){
+            entity* en = en_kv.second;
+            en->for_each_component([this, en](component_id id, void*){
+                component_entity_set(id).insert(en);
+            });
+        }
+
+        if (mather_group_map_.empty()){
+            return;
+        }
+
+        for (auto& en_kv : entity_map_){
+            for (auto& gp_kv : mather_group_map_){
+                gp_kv.second->handle_entity_match(en_kv.second);
+            }
+        }
+
+        for (auto& gp_kv : mather_group_map_){
+            set_group_ready(gp_kv.second);
+        }
+    }
+
 protected:
+    group* check_or_create_group(const matcher::ptr& mther, group_population mode){
+        if (!mther){
+            return nullptr;
+        }
+
+        group* gp = find_group(*mther);
+        if (gp){
+            return gp;
+        }
+
+        // new create a group
+        gp = new group(mther, this);
+        if (!entity_map_.empty()){
+            if (mode == group_populate_eager){
+                for (auto& en_kv : entity_map_){
+                    gp->handle_entity_match(en_kv.second);
+                }
+            }
+            else if (mode == group_populate_lazy){
+                gp->ready_ = false;
+            }
+            else{
+                // only the ids are taken now, they are matched over the ticks
+                gp->ready_ = false;
+                gp->pending_ids_.reserve(entity_map_.size());
+                for (auto& en_kv : entity_map_){
+                    gp->pending_ids_.push_back(en_kv.first);
+                }
+                warming_groups_.push_back(gp);
+            }
+        }
+        mather_group_map_.insert(std::make_pair(mther->hash_code(), gp));
+
+        // todo, fire group create event
+        return gp;
+    }
+
+    /**
+     * @brief match up to budget pending entitys of the warming group
+     * @return the count of the matched entitys
+     */
+    std::size_t warm_group(group* gp, std::size_t budget){
+        std::size_t count = 0;
+        while (count < budget && gp->pending_pos_ < gp->pending_ids_.size()){
+            // the entitys destoryed since the creation are skipped
+            entity* en = get_entity(gp->pending_ids_[gp->pending_pos_++]);
+            if (en){
+                gp->handle_entity_match(en);
+            }
+            ++count;
+        }
+        return count;
+    }
+
+    void set_group_ready(group* gp){
+        if (!gp->pending_ids_.empty()){
+            std::vector<int64_t>().swap(gp->pending_ids_);
+            gp->pending_pos_ = 0;
+            warming_groups_.erase(std::remove(warming_groups_.begin(), warming_groups_.end(), gp), warming_groups_.end());
+        }
+        gp->ready_ = true;
+    }
+
+    /**
+     * @brief drive from the entitys of each any-of component in turn, an entity is visited
+     * only from its first any-of component
+     */
+    template<typename F>
+    void query_any_of(matcher& mther, const component_type_list& any_list, F f){
+        for (std::size_t i = 0; i < any_list.size(); ++i){
+            const entity_set* ens = component_entitys(any_list[i]);
+            if (!ens){
+                continue;
+            }
+
+            for (entity* en : *ens){
+                bool visited = false;
+                for (std::size_t j = 0; j < i && !visited; ++j){
+                    visited = en->has_component(any_list[j]);
+                }
+                if (!visited && en->enabled() && mther.matches(en)){
+                    f(en);
+                }
+            }
+        }
+    }
+
     int64_t generate_next_entity_id(){
         return ++next_entity_id_;
     }
+
+    /**
+     * @brief create the entity with the specific id, no event fired(bulk load)
+     * @return nullptr if the id is already used(a corrupted snapshot), the existing entity is kept
+     */
+    entity* create_entity_no_event(int64_t id){
+        if (entity_map_.find(id) != entity_map_.end()){
+            return nullptr;
+        }
+
+        entity* en = new (entity_memory_pool_.allocate()) entity(id, this);
+        entity_map_[id] = en;
+        if (id > next_entity_id_){
+            next_entity_id_ = id;
+        }
+        return en;
+    }
+
+    /**
+     * @brief create the entity with the specific id and fire the create event(recovery)
+     */
+    entity* restore_entity(int64_t id){
+        entity* en = create_entity_no_event(id);
+        if (!en){
+            return nullptr;
+        }
+
+        // fire entity create event 
+        entity_create_event_publisher_.publish_event(en);
+
+        return en;
+    }
 };
 }
 
@@ -12,34 +12,94 @@
 #ifndef __ydk_ecs_entity_manager_iface_hpp__
 #define __ydk_ecs_entity_manager_iface_hpp__
 
+#include <ecs_cpp/event.hpp>
+#include <ecs_cpp/signature.hpp>
+#include <ecs_cpp/shared_component.hpp>
+#include <ecs_cpp/reserve_hints.hpp>
 #include <utility/pool/memory_pool.hpp>
+#include <utility/pool/memory_resource.hpp>
 #include <utility/sync/null_mutex.hpp>
 #include <cstdint>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace ecs_cpp
 {
 class entity;
 class component;
-typedef uint32_t component_id;
+class group;
 
 typedef utility::memory_pool<utility::sync::null_mutex> memory_pool_type;
+typedef std::unordered_set<entity*, std::hash<entity*>, std::equal_to<entity*>, utility::resource_allocator<entity*>> entity_set;
 
 class entity_manager_iface
 {
 protected:
+    /** the entity records, the component pools and the containers allocate from it */
+    utility::memory_resource*   resource_;
+
     std::unordered_map<component_id, memory_pool_type*> component_pool_map_;
 
+    /** the grow policy of the pools, and <component id, the cell count reserved when its pool is created> */
+    utility::pool_grow_policy                   pool_grow_policy_;
+    uint32_t                                    pool_grow_count_;
+    std::unordered_map<component_id, uint32_t>  pool_reserve_counts_;
+
+    /** the interned values of the shared components */
+    std::unordered_map<component_id, shared_component_store_base*> shared_store_map_;
+
+    /** <component id, the entitys that have the component>, the candidates of the query planner */
+    std::unordered_map<component_id, entity_set, std::hash<component_id>, std::equal_to<component_id>,
+        utility::resource_allocator<std::pair<const component_id, entity_set>>> component_entitys_;
+
+    /** 
+     * manager level component events, fired for the components of all the entitys
+     * not fired for the components that dropped with a destoryed entity(the entity remove event covers them)
+     */
+    /* <entity, component id, new added component> */
+    event_publisher<entity*, component_id, void*> component_added_event_publisher_;
+
+    /* <entity, component id, old component, new component> */
+    event_publisher<entity*, component_id, void*, void*> component_replaced_event_publisher_;
+
+    /* <entity, component id, removed component> */
+    event_publisher<entity*, component_id, void*> component_removed_event_publisher_;
+
+    /* <entity, component id, component>, the component is modified in place */
+    event_publisher<entity*, component_id, void*> component_changed_event_publisher_;
+
+    /* <entity, enabled>, the entity is enabled/disabled, its components are unchanged */
+    event_publisher<entity*, bool> entity_enabled_event_publisher_;
+
 public:
-    entity_manager_iface(){}
+    /**
+     * @param resource - the memory resource(eg. a monotonic arena for a short-lived context) that must
+     * outlive the manager, the global heap if null
+     */
+    explicit entity_manager_iface(utility::memory_resource* resource = nullptr)
+        : resource_(resource ? resource : utility::default_memory_resource())
+        , pool_grow_policy_(utility::pool_grow_geometric)
+        , pool_grow_count_(16)
+        , component_entitys_(0, std::hash<component_id>(), std::equal_to<component_id>(), resource_)
+    {
+    }
     virtual ~entity_manager_iface(){
         for (auto& cp_pool_kv : component_pool_map_){
             delete cp_pool_kv.second;
         }
         component_pool_map_.clear();
+
+        for (auto& store_kv : shared_store_map_){
+            delete store_kv.second;
+        }
+        shared_store_map_.clear();
     }
 
 public:
+    utility::memory_resource* resource() const{
+        return resource_;
+    }
+
     memory_pool_type* get_component_pool(component_id id){
         auto iter = component_pool_map_.find(id);
         if (iter != component_pool_map_.end()){
@@ -53,12 +113,190 @@ public:
         component_id type_id = typeid(C).hash_code();
         memory_pool_type* pool = get_component_pool(type_id);
         if (!pool){
-            pool = new utility::memory_pool_ex<C, utility::sync::null_mutex>(1);
+            auto iter = pool_reserve_counts_.find(type_id);
+            pool = new utility::memory_pool_ex<C, utility::sync::null_mutex>(
+                iter != pool_reserve_counts_.end() ? iter->second : 0, 1, resource_);
+            pool->set_grow_policy(pool_grow_policy_, pool_grow_count_);
             component_pool_map_[type_id] = pool;
         }
         return pool;
     }
 
+    /**
+     * @brief set the grow policy of the pools, the default is geometric with at least 16 cells per grow
+     */
+    virtual void set_pool_grow_policy(utility::pool_grow_policy policy, uint32_t grow_cell_count){
+        pool_grow_policy_ = policy;
+        pool_grow_count_ = grow_cell_count;
+        for (auto& cp_pool_kv : component_pool_map_){
+            cp_pool_kv.second->set_grow_policy(policy, grow_cell_count);
+        }
+    }
+
+    shared_component_store_base* get_shared_store(component_id id){
+        auto iter = shared_store_map_.find(id);
+        if (iter != shared_store_map_.end()){
+            return iter->second;
+        }
+        return nullptr;
+    }
+
+    template<typename C>
+    shared_component_store<C>* check_or_create_shared_store(){
+        component_id type_id = typeid(C).hash_code();
+        shared_component_store_base* store = get_shared_store(type_id);
+        if (!store){
+            store = new shared_component_store<C>();
+            shared_store_map_[type_id] = store;
+        }
+        return static_cast<shared_component_store<C>*>(store);
+    }
+
+    /**
+     * @brief visit the distinct values of the shared component with their entitys(batch processing),
+     * f(const C& value, const std::unordered_set<entity*>& entitys)
+     */
+    template<typename C, typename F>
+    void for_each_shared(F f){
+        shared_component_store_base* store = get_shared_store(typeid(C).hash_code());
+        if (store){
+            static_cast<shared_component_store<C>*>(store)->for_each(f);
+        }
+    }
+
+    /**
+     * @brief the count of the distinct values of the shared component
+     */
+    template<typename C>
+    std::size_t shared_value_count(){
+        shared_component_store_base* store = get_shared_store(typeid(C).hash_code());
+        return store ? store->value_count() : 0;
+    }
+
+    /** 
+     * @brief sub/unsubscribe the component added event of all the entitys
+     * @mode - 1, subscribe, 0 unsubscribe
+     */
+    void subscribe_component_added_event(event_subscriber<entity*, component_id, void*>* sub, int32_t mode){
+        if (mode == 1){
+            component_added_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            component_added_event_publisher_.unsubscribe(sub);
+        }
+    }
+
+    /** 
+     * @brief sub/unsubscribe the component replace event of all the entitys
+     */
+    void subscribe_component_replace_event(event_subscriber<entity*, component_id, void*, void*>* sub, int32_t mode){
+        if (mode == 1){
+            component_replaced_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            component_replaced_event_publisher_.unsubscribe(sub);
+        }
+    }
+
+    /** 
+     * @brief sub/unsubscribe the component remove event of all the entitys
+     */
+    void subscribe_component_remove_event(event_subscriber<entity*, component_id, void*>* sub, int32_t mode){
+        if (mode == 1){
+            component_removed_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            component_removed_event_publisher_.unsubscribe(sub);
+        }
+    }
+
+    /** 
+     * @brief sub/unsubscribe the component changed event of all the entitys
+     * fired by entity::patch_component/mark_changed, the component address is unchanged
+     */
+    void subscribe_component_change_event(event_subscriber<entity*, component_id, void*>* sub, int32_t mode){
+        if (mode == 1){
+            component_changed_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            component_changed_event_publisher_.unsubscribe(sub);
+        }
+    }
+
+    /** 
+     * @brief sub/unsubscribe the entity enable/disable event
+     */
+    void subscribe_entity_enable_event(event_subscriber<entity*, bool>* sub, int32_t mode){
+        if (mode == 1){
+            entity_enabled_event_publisher_.subscribe(sub);
+        }
+        else if (mode == 0){
+            entity_enabled_event_publisher_.unsubscribe(sub);
+        }
+    }
+
+    /**
+     * @brief the entitys that have the component, nullptr if none ever had
+     */
+    const entity_set* component_entitys(component_id id) const{
+        auto iter = component_entitys_.find(id);
+        if (iter != component_entitys_.end()){
+            return &iter->second;
+        }
+        return nullptr;
+    }
+
+    /** fired by the entity */
+    void notify_component_added(entity* en, component_id id, void* comp){
+        component_entity_set(id).insert(en);
+        component_added_event_publisher_.publish_event(en, id, comp);
+    }
+
+    void notify_component_replaced(entity* en, component_id id, void* old_comp, void* new_comp){
+        component_replaced_event_publisher_.publish_event(en, id, old_comp, new_comp);
+    }
+
+    void notify_component_changed(entity* en, component_id id, void* comp){
+        component_changed_event_publisher_.publish_event(en, id, comp);
+    }
+
+    void notify_entity_enabled(entity* en, bool enabled){
+        entity_enabled_event_publisher_.publish_event(en, enabled);
+    }
+
+    void notify_component_removed(entity* en, component_id id, void* comp){
+        unindex_component(en, id);
+        component_removed_event_publisher_.publish_event(en, id, comp);
+    }
+
+protected:
+    entity_set& component_entity_set(component_id id){
+        auto iter = component_entitys_.find(id);
+        if (iter == component_entitys_.end()){
+            iter = component_entitys_.insert(std::make_pair(id, make_entity_set())).first;
+        }
+        return iter->second;
+    }
+
+    entity_set make_entity_set() const{
+        return entity_set(0, entity_set::hasher(), entity_set::key_equal(), entity_set::allocator_type(resource_));
+    }
+
+    /** drop the component index and the shared values, the entitys are dropped in bulk */
+    void clear_component_index(){
+        component_entitys_.clear();
+        for (auto& store_kv : shared_store_map_){
+            store_kv.second->clear();
+        }
+    }
+
+    void unindex_component(entity* en, component_id id){
+        auto iter = component_entitys_.find(id);
+        if (iter != component_entitys_.end()){
+            iter->second.erase(en);
+        }
+    }
+
 public:
     /** 
      * @brief sub/unsubsribe the entity created event
@@ -72,6 +310,11 @@ public:
      */
     virtual void subscribe_entity_remove_event(event_subscriber<entity*>* sub, int32_t mode) = 0;
 
+    /** 
+     * @brief sub/unsubscribe the clear event(all the entitys are dropped at once)
+     */
+    virtual void subscribe_clear_event(event_subscriber<>* sub, int32_t mode) = 0;
+
     /** 
      * @brief create the entity
      */
@@ -81,6 +324,11 @@ public:
      * @brief destory the entity
      */
     virtual void destory(entity* en) = 0;
+
+    /** 
+     * @brief match all the entitys that are not matched yet of the lazy/warming group, called at its first iteration
+     */
+    virtual void populate_group(group* gp) = 0;
 };
 }
 
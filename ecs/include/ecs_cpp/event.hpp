@@ -80,6 +80,10 @@ public:
         }
     }
 
+    bool empty() const{
+        return subscribers_.empty();
+    }
+
     void publish_event(Args... args){
         auto subscribers_tmp = subscribers_;
         for (auto& subscriber : subscribers_tmp){
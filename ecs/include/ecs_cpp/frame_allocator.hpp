@@ -0,0 +1,168 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: frame_allocator.hpp
+ *
+ * the per tick scratch memory of the systems, one linear arena per thread,
+ * rewound by system_manager at the end of each update pass(system_manager(context&) wires it),
+ * or by system_manager::end_frame when the systems are updated one by one
+ * the arena of a thread is found without the lock, for up to thread_cache_slots allocators used by the thread
+ *
+ *  int64_t* candidates = ctx.frame_alloc<int64_t>(count);
+ *  std::vector<entity*, utility::resource_allocator<entity*>> list(ctx.frame().resource());
+ */
+
+#ifndef __ydk_ecs_frame_allocator_hpp__
+#define __ydk_ecs_frame_allocator_hpp__
+
+#include <utility/pool/linear_arena.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+
+namespace ecs_cpp
+{
+class frame_allocator
+{
+protected:
+    struct thread_cache_t{
+        uint64_t                serial;
+        utility::linear_arena*  arena;
+    };
+
+    /** the allocators a thread can alternate between without the lock */
+    static const uint32_t       thread_cache_slots = 4;
+
+    /** process wide unique, the thread local cache can't be confused by a new allocator at the same address */
+    uint64_t                    serial_;
+    std::size_t                 chunk_size_;
+    utility::memory_resource*   upstream_;
+
+    std::mutex                  mutex_;
+    std::unordered_map<std::thread::id, std::unique_ptr<utility::linear_arena>> arenas_;
+
+    /** the system_managers that rewind it */
+    std::atomic<uint32_t>       manager_count_;
+
+public:
+    /**
+     * @param chunk_size - the first chunk size of each arena
+     * @param upstream - where the chunks come from, the global heap if null
+     */
+    explicit frame_allocator(std::size_t chunk_size = 64 * 1024, utility::memory_resource* upstream = nullptr)
+        : serial_(next_serial())
+        , chunk_size_(chunk_size)
+        , upstream_(upstream)
+        , manager_count_(0)
+    {
+    }
+
+    frame_allocator(const frame_allocator&) = delete;
+    frame_allocator& operator = (const frame_allocator&) = delete;
+
+public:
+    /**
+     * @brief the arena of the calling thread, created at the first use of the thread
+     */
+    utility::linear_arena& arena(){
+        thread_cache_t* caches = thread_caches();
+        for (uint32_t i = 0; i < thread_cache_slots; ++i){
+            if (caches[i].serial == serial_){
+                return *caches[i].arena;
+            }
+        }
+
+        utility::linear_arena* found = nullptr;
+        {
+            std::lock_guard<std::mutex> locker(mutex_);
+            std::unique_ptr<utility::linear_arena>& arena = arenas_[std::this_thread::get_id()];
+            if (!arena){
+                arena.reset(new utility::linear_arena(chunk_size_, upstream_));
+            }
+            found = arena.get();
+        }
+
+        // replace the slots round robin, the slot of a destroyed allocator is never matched again
+        static thread_local uint32_t next_slot = 0;
+        thread_cache_t& cache = caches[next_slot];
+        next_slot = (next_slot + 1) % thread_cache_slots;
+        cache.serial = serial_;
+        cache.arena = found;
+        return *found;
+    }
+
+    /**
+     * @brief the arena of the calling thread as a memory resource, for the containers
+     */
+    utility::memory_resource* resource(){
+        return &arena();
+    }
+
+    /**
+     * @brief uninitialized storage of n T, valid until the reset(the end of the update pass)
+     * the destructors never run, so T must be trivially destructible
+     */
+    template<typename T>
+    T*  alloc(std::size_t n){
+        static_assert(std::is_trivially_destructible<T>::value, "the frame memory is rewound without the destructors");
+        return static_cast<T*>(arena().allocate(n * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * @brief rewind the arenas of all the threads, no thread may use the frame memory meanwhile
+     */
+    void reset(){
+        std::lock_guard<std::mutex> locker(mutex_);
+        for (auto& arena_kv : arenas_){
+            arena_kv.second->reset();
+        }
+    }
+
+    /**
+     * @brief the max bytes used between two resets, of all the threads
+     */
+    std::size_t high_water(){
+        std::lock_guard<std::mutex> locker(mutex_);
+        std::size_t total = 0;
+        for (auto& arena_kv : arenas_){
+            total += arena_kv.second->high_water();
+        }
+        return total;
+    }
+
+    uint32_t arena_count(){
+        std::lock_guard<std::mutex> locker(mutex_);
+        return arenas_.size();
+    }
+
+    /** called by system_manager::set_frame_allocator */
+    void attach_manager(){
+        ++manager_count_;
+    }
+
+    void detach_manager(){
+        --manager_count_;
+    }
+
+    /** whether a system_manager rewinds the memory after each update pass */
+    bool managed() const{
+        return manager_count_ > 0;
+    }
+
+protected:
+    static uint64_t next_serial(){
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+
+    static thread_cache_t* thread_caches(){
+        static thread_local thread_cache_t caches[thread_cache_slots] = {};
+        return caches;
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -17,26 +17,138 @@
 #include <ecs_cpp/event.hpp>
 #include <ecs_cpp/entity_manager_iface.hpp>
 #include <unordered_set>
+#include <iterator>
+#include <vector>
 
 namespace ecs_cpp
 {
+/** how a new group is filled with the existing entitys */
+enum group_population
+{
+    group_populate_eager        = 0,    // match all the entitys when created
+    group_populate_lazy         = 1,    // match all the entitys at the first iteration
+    group_populate_incremental  = 2,    // match a budget of entitys per entity_manager::warm_groups, ready when done
+};
+
+/**
+ * @brief the enabled entitys of an entity set, the disabled ones are skipped while iterating
+ */
+class enabled_entity_view
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef entity*                     value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef entity* const*              pointer;
+        typedef entity* const&              reference;
+
+    protected:
+        entity_set::const_iterator  iter_;
+        entity_set::const_iterator  end_;
+
+    public:
+        iterator(entity_set::const_iterator iter, entity_set::const_iterator end)
+            : iter_(iter), end_(end){
+            skip_disabled();
+        }
+
+        reference operator*() const{
+            return *iter_;
+        }
+
+        iterator& operator++(){
+            ++iter_;
+            skip_disabled();
+            return *this;
+        }
+
+        iterator operator++(int){
+            iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        bool operator == (const iterator& other) const{
+            return iter_ == other.iter_;
+        }
+
+        bool operator != (const iterator& other) const{
+            return iter_ != other.iter_;
+        }
+
+    protected:
+        void skip_disabled(){
+            while (iter_ != end_ && !(*iter_)->enabled()){
+                ++iter_;
+            }
+        }
+    };
+
+protected:
+    const entity_set*   entitys_;
+    uint32_t            size_;
+
+public:
+    /** @param size - the count of the enabled entitys */
+    enabled_entity_view(const entity_set& entitys, uint32_t size)
+        : entitys_(&entitys), size_(size){
+    }
+
+    iterator begin() const{
+        return iterator(entitys_->begin(), entitys_->end());
+    }
+
+    iterator end() const{
+        return iterator(entitys_->end(), entitys_->end());
+    }
+
+    uint32_t size() const{
+        return size_;
+    }
+
+    bool empty() const{
+        return size_ == 0;
+    }
+};
+
 class group
 {
 public:
     typedef std::shared_ptr<group> ptr;
+    friend class entity_manager;
 protected:
     matcher::ptr                mather_;
-    std::unordered_set<entity*> entitis_;
+
+    /** the matched entitys, the disabled ones included(skipped by the iteration) */
+    entity_set                  entitis_;
+
+    /** the count of the disabled entitys in entitis_ */
+    uint32_t                    disabled_count_;
     entity_manager_iface*       entity_mgr_;
 
-    /** <entity, new added component*> */
-    event_subscriber<entity*, component*> component_added_event_subscriber_;
+    /** the group is released with the last reference, unless it's pinned by entity_manager::get_group */
+    uint32_t                    ref_count_;
+    bool                        pinned_;
+
+    /** 
+     * not ready until all the entitys that existed at the creation are matched,
+     * the entitys changed after the creation are matched by the events anyway
+     */
+    bool                        ready_;
+    std::vector<int64_t>        pending_ids_;       // the entitys to match of the incremental population
+    std::size_t                 pending_pos_;
+
+    /** <entity, component id, new added component*> */
+    event_subscriber<entity*, component_id, void*> component_added_event_subscriber_;
 
-    /** <entity, old component, new component*> */
-    event_subscriber<entity*, component*, component*> component_replace_event_subsciber_;
+    /** <entity, component id, old component, new component*> */
+    event_subscriber<entity*, component_id, void*, void*> component_replace_event_subsciber_;
 
-    /** <entity, removed component*> */
-    event_subscriber<entity*, component*> component_removed_subscriber_;
+    /** <entity, component id, removed component*> */
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
 
     /** <entity> */
     event_subscriber<entity*> entity_added_subscriber_;
@@ -44,6 +156,15 @@ protected:
     /** <entity> */
     event_subscriber<entity*> entity_removed_subscriber_;
 
+    /** <entity, enabled> */
+    event_subscriber<entity*, bool> entity_enabled_subscriber_;
+
+    /** <entity, component id, changed component*>, only subscribed while the group has changed subscribers */
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+    /** the changed feed of the group, <member entity, component id, changed component*> */
+    event_publisher<entity*, component_id, void*> entity_changed_event_publisher_;
+
 public:
     static group::ptr create(matcher::ptr mther, entity_manager_iface* entity_mgr){
         return std::make_shared<group>(mther, entity_mgr);
@@ -52,38 +173,121 @@ public:
 public:
     group(matcher::ptr mather, entity_manager_iface* entity_mgr)
         : mather_(mather)
+        , entitis_(0, entity_set::hasher(), entity_set::key_equal(), entity_mgr ? entity_mgr->resource() : nullptr)
+        , disabled_count_(0)
         , entity_mgr_(entity_mgr)
+        , ref_count_(0)
+        , pinned_(false)
+        , ready_(true)
+        , pending_pos_(0)
     {
         initailize_event_subscriber();
 
-        // subscribe entity create/remove events
+        // subscribe entity create/remove and component events
         subscriber_entity_events(1);
     }
 
     ~group(){
-
-        // unsubscribe all the entitys of the group
-        while (!entitis_.empty()){
-            entity* en = *entitis_.begin();
-            remove_entity(en);
-        }
-
-        // unsubscribe entity create/remove events
+        // unsubscribe entity create/remove and component events
         subscriber_entity_events(0);
+        if (entity_mgr_ && !entity_changed_event_publisher_.empty()){
+            entity_mgr_->subscribe_component_change_event(&component_changed_subscriber_, 0);
+        }
     }
 
+    /**
+     * @brief the count of the enabled entitys
+     */
     uint32_t entity_count(){
-        return entitis_.size();
+        ensure_ready();
+        return entitis_.size() - disabled_count_;
     }
 
-    const std::unordered_set<entity*>& entities(){
+    /**
+     * @brief the enabled entitys of the group, the disabled ones are skipped while iterating
+     */
+    enabled_entity_view entities(){
+        ensure_ready();
+        return enabled_entity_view(entitis_, entitis_.size() - disabled_count_);
+    }
+
+    /**
+     * @brief all the matched entitys, the disabled ones included
+     */
+    const entity_set& members(){
+        ensure_ready();
         return entitis_;
     }
 
+    /**
+     * @brief the count of the matched entitys that are disabled
+     */
+    uint32_t disabled_entity_count(){
+        ensure_ready();
+        return disabled_count_;
+    }
+
+    /**
+     * @brief whether the group has matched all the entitys, a group that is not ready
+     * is populated synchronously at the first iteration
+     */
+    bool ready() const{
+        return ready_;
+    }
+
+    void ensure_ready(){
+        if (!ready_ && entity_mgr_){
+            entity_mgr_->populate_group(this);
+        }
+    }
+
     matcher::ptr matcher(){
         return mather_;
     }
 
+    /**
+     * @brief sub/unsub the changed feed: a component of the matcher of an enabled member entity is
+     * replaced, patched or marked changed(entity::patch_component/mark_changed)
+     * the group only follows the changed events while it has subscribers
+     * @mode - 1, subscribe, 0 unsubscribe
+     */
+    void subscribe_entity_changed_event(event_subscriber<entity*, component_id, void*>* sub, int32_t mode){
+        if (mode == 1){
+            entity_changed_event_publisher_.subscribe(sub);
+        }
+        else{
+            entity_changed_event_publisher_.unsubscribe(sub);
+        }
+
+        if (entity_mgr_){
+            entity_mgr_->subscribe_component_change_event(&component_changed_subscriber_, entity_changed_event_publisher_.empty() ? 0 : 1);
+        }
+    }
+
+    void retain(){
+        ++ref_count_;
+    }
+
+    /** @return the remaining reference count */
+    uint32_t release(){
+        if (ref_count_ > 0){
+            --ref_count_;
+        }
+        return ref_count_;
+    }
+
+    uint32_t ref_count() const{
+        return ref_count_;
+    }
+
+    void pin(){
+        pinned_ = true;
+    }
+
+    bool pinned() const{
+        return pinned_;
+    }
+
     void handle_entity_match(entity* en){
         if (!mather_ || !en ){
             return;
@@ -98,59 +302,80 @@ public:
     }
 
 protected:
-    void    add_entity(entity* en){
-        entitis_.insert(en);
-
-        // subscribe the entity events
-        subscribe_entity_component_events(en, 1);
+    /** all the entitys are dropped(entity_manager::clear) */
+    void    clear_entities(){
+        entitis_.clear();
+        disabled_count_ = 0;
     }
 
-    void    remove_entity(entity* en){
-        entitis_.erase(en);
-
-        // unsubscribe the entity envents
-        subscribe_entity_component_events(en, 0);
+    void    add_entity(entity* en){
+        if (entitis_.insert(en).second && !en->enabled()){
+            ++disabled_count_;
+        }
     }
 
-    void    subscribe_entity_component_events(entity* en, int32_t mode){
-        en->subscribe_component_added_event(&component_added_event_subscriber_, mode);
-        en->subscribe_component_replace_event(&component_replace_event_subsciber_, mode);
-        en->subscribe_component_remove_event(&component_removed_subscriber_, mode);
+    void    remove_entity(entity* en){
+        if (entitis_.erase(en) > 0 && !en->enabled()){
+            --disabled_count_;
+        }
     }
 
+    /**
+     * the component events come from the entity manager, an entity that is not in the group
+     * yet must be rematched when it gets the components
+     */
     void    subscriber_entity_events(int32_t mode){
         if (entity_mgr_){
             entity_mgr_->subscribe_entity_create_event(&entity_added_subscriber_, mode);
             entity_mgr_->subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+            entity_mgr_->subscribe_entity_enable_event(&entity_enabled_subscriber_, mode);
+            entity_mgr_->subscribe_component_added_event(&component_added_event_subscriber_, mode);
+            entity_mgr_->subscribe_component_replace_event(&component_replace_event_subsciber_, mode);
+            entity_mgr_->subscribe_component_remove_event(&component_removed_subscriber_, mode);
         }
     }
 
     void    initailize_event_subscriber(){
         // entity component events
         component_added_event_subscriber_.register_event_handler(
-            std::bind(&group::event_entity_component_added, this, std::placeholders::_1, std::placeholders::_2));
+            std::bind(&group::event_entity_component_added, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         component_replace_event_subsciber_.register_event_handler(
-            std::bind(&group::event_entity_component_replaced, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            std::bind(&group::event_entity_component_replaced, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
         component_removed_subscriber_.register_event_handler(
-            std::bind(&group::event_entity_component_removed, this, std::placeholders::_1, std::placeholders::_2));
+            std::bind(&group::event_entity_component_removed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
         // entity events
         entity_added_subscriber_.register_event_handler(
             std::bind(&group::event_entity_added, this, std::placeholders::_1));
         entity_removed_subscriber_.register_event_handler(
             std::bind(&group::event_entity_removed, this, std::placeholders::_1));
+        entity_enabled_subscriber_.register_event_handler(
+            std::bind(&group::event_entity_enabled, this, std::placeholders::_1, std::placeholders::_2));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&group::event_entity_component_changed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     }
 
-    void    event_entity_component_added(entity* en, component* added_comp){
-        handle_entity_match(en);
+    void    event_entity_component_added(entity* en, component_id id, void* /*added_comp*/){
+        if (mather_ && mather_->involves(id)){
+            handle_entity_match(en);
+        }
     }
 
-    void    event_entity_component_replaced(entity* en, component* old_comp, component* new_comp){
-        handle_entity_match(en);
+    void    event_entity_component_replaced(entity* en, component_id id, void* /*old_comp*/, void* new_comp){
+        // the component set is not changed, neither is the membership, only the value
+        event_entity_component_changed(en, id, new_comp);
     }
 
-    void    event_entity_component_removed(entity* en, component* removed_comp){
-        handle_entity_match(en);
+    void    event_entity_component_changed(entity* en, component_id id, void* comp){
+        if (!entity_changed_event_publisher_.empty() && en->enabled() && mather_ && mather_->involves(id) && entitis_.count(en) > 0){
+            entity_changed_event_publisher_.publish_event(en, id, comp);
+        }
+    }
+
+    void    event_entity_component_removed(entity* en, component_id id, void* /*removed_comp*/){
+        if (mather_ && mather_->involves(id)){
+            handle_entity_match(en);
+        }
     }
 
     void    event_entity_added(entity* en){
@@ -160,6 +385,18 @@ protected:
     void    event_entity_removed(entity* en){
         remove_entity(en);
     }
+
+    /** the membership is unchanged, only the disabled count of a member is updated */
+    void    event_entity_enabled(entity* en, bool enabled){
+        if (entitis_.count(en) > 0){
+            if (enabled){
+                --disabled_count_;
+            }
+            else{
+                ++disabled_count_;
+            }
+        }
+    }
 };
 }
 
@@ -0,0 +1,625 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: journal.hpp
+ *
+ * append only journal of the structural changes and the component writes, for the crash recovery
+ *
+ * the records of a tick are buffered in the memory, commit_tick() hands them to the writer thread,
+ * which appends them to the file and fsyncs per tick or every N ms(group commit), so the tick never
+ * waits for the disk. the recovery loads the last snapshot and replays the committed ticks.
+ *
+ * journal format(streaming, a segment can be compacted once the writer rotates to the next one):
+ *  header:  magic(u32) version(u32)
+ *  records: length(u32) checksum(u32, fnv1a of the payload) payload
+ *      payload: op(u8) entity_id(varint) [component_id(varint) [size(varint) data]] | op(u8) tick(varint) | op(u8)(clear)
+ *          | op(u8) entity_id(varint) enabled(u8), since version 2
+ *  a torn or corrupted tail is dropped, and so are the records after the last tick commit
+ */
+
+#ifndef __ydk_ecs_journal_hpp__
+#define __ydk_ecs_journal_hpp__
+
+#include <ecs_cpp/context.hpp>
+#include <ecs_cpp/serialization.hpp>
+#include <ecs_cpp/snapshot.hpp>
+#include <utility/io/binary_stream.hpp>
+#include <utility/io/mapped_file.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ecs_cpp
+{
+enum journal_op
+{
+    journal_op_create_entity    = 1,
+    journal_op_destory_entity   = 2,
+    journal_op_set_component    = 3,
+    journal_op_remove_component = 4,
+    journal_op_commit_tick      = 5,
+    journal_op_clear            = 6,    // entity_manager::clear, all the entitys are dropped
+    journal_op_set_enabled      = 7,    // entity::set_enabled
+};
+
+enum journal_sync_policy
+{
+    journal_sync_per_tick       = 0,    // fsync after every committed tick
+    journal_sync_interval       = 1,    // fsync every sync_interval_ms
+};
+
+static const uint32_t journal_magic     = 0x4a534345;   // "ECSJ"
+static const uint32_t journal_version   = 2;
+
+namespace detail
+{
+    inline uint32_t fnv1a(const uint8_t* data, std::size_t size){
+        uint32_t hash = 2166136261u;
+        for (std::size_t i = 0; i < size; ++i){
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /** @return false if the data can't be flushed to the disk */
+    inline bool sync_file(FILE* f){
+        if (fflush(f) != 0){
+            return false;
+        }
+#if defined(_WIN32)
+        return _commit(_fileno(f)) == 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+
+    inline bool write_file(FILE* f, const uint8_t* data, std::size_t size){
+        return fwrite(data, 1, size, f) == size && sync_file(f);
+    }
+}
+
+class journal_writer
+{
+protected:
+    entity_manager&                     entity_mgr_;
+    const component_codec_registry&     registry_;
+    journal_sync_policy                 policy_;
+    uint32_t                            sync_interval_ms_;
+
+    /** the records of the current tick, only touched by the simulation thread */
+    utility::io::binary_writer          active_;
+    utility::io::binary_writer          comp_writer_;
+    std::size_t                         record_begin_;
+    uint64_t                            tick_;
+
+    /** shared with the writer thread */
+    FILE*                               file_;
+    std::vector<uint8_t>                pending_;
+    uint64_t                            committed_tick_;
+    uint64_t                            durable_tick_;
+    bool                                flush_requested_;
+    bool                                stop_;
+    /** latched on a write/fsync error(eg. disk full), the ticks after it never become durable */
+    bool                                failed_;
+    std::mutex                          mutex_;
+    std::condition_variable             pending_cond_;
+    std::condition_variable             durable_cond_;
+    std::thread                         thread_;
+
+    event_subscriber<entity*>   entity_created_subscriber_;
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, bool> entity_enabled_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+public:
+    /**
+     * @brief attach the journal right after a snapshot, it records the changes since then
+     * @param sync_interval_ms: only for journal_sync_interval
+     */
+    journal_writer(entity_manager& entity_mgr, const component_codec_registry& registry,
+        journal_sync_policy policy = journal_sync_per_tick, uint32_t sync_interval_ms = 10)
+        : entity_mgr_(entity_mgr)
+        , registry_(registry)
+        , policy_(policy)
+        , sync_interval_ms_(sync_interval_ms)
+        , record_begin_(0)
+        , tick_(0)
+        , file_(nullptr)
+        , committed_tick_(0)
+        , durable_tick_(0)
+        , flush_requested_(false)
+        , stop_(false)
+        , failed_(false)
+    {
+        entity_created_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_entity_created, this, std::placeholders::_1));
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_cleared, this));
+        entity_enabled_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_entity_enabled, this, std::placeholders::_1, std::placeholders::_2));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_component_set, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_component_set, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_4));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_component_removed, this, std::placeholders::_1, std::placeholders::_2));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&journal_writer::event_component_set, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    ~journal_writer(){
+        close();
+    }
+
+public:
+    /**
+     * @brief open the journal segment(truncated) and start the writer thread
+     */
+    bool open(const std::string& path){
+        close();
+
+        file_ = fopen(path.c_str(), "wb");
+        if (!file_){
+            return false;
+        }
+
+        utility::io::binary_writer header;
+        header.write_u32(journal_magic);
+        header.write_u32(journal_version);
+        if (!detail::write_file(file_, header.data(), header.size())){
+            fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+
+        stop_ = false;
+        flush_requested_ = false;
+        failed_ = false;
+        thread_ = std::thread(&journal_writer::writer_thread, this);
+        subscribe_events(1);
+        return true;
+    }
+
+    /**
+     * @brief commit the records of the current tick, the write and fsync happen on the writer thread
+     * @return false if the journal is not open or has failed, the tick will never be durable
+     */
+    bool commit_tick(){
+        if (!file_){
+            return false;
+        }
+
+        ++tick_;
+        begin_record();
+        active_.write_u8(journal_op_commit_tick);
+        active_.write_varint(tick_);
+        end_record();
+
+        {
+            std::lock_guard<std::mutex> locker(mutex_);
+            if (failed_){
+                active_.clear();
+                return false;
+            }
+            pending_.insert(pending_.end(), active_.data(), active_.data() + active_.size());
+            committed_tick_ = tick_;
+        }
+        active_.clear();
+
+        if (policy_ == journal_sync_per_tick){
+            pending_cond_.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * @brief block until all the committed ticks are durable
+     * @return false if the journal has failed, durable_tick() is the last tick that made it to the disk
+     */
+    bool flush(){
+        std::unique_lock<std::mutex> locker(mutex_);
+        flush_requested_ = true;
+        pending_cond_.notify_one();
+        durable_cond_.wait(locker, [this](){ return durable_tick_ >= committed_tick_ || failed_ || !thread_.joinable(); });
+        return !failed_;
+    }
+
+    /**
+     * @brief continue in a new segment at the tick boundary, the uncommitted records move with it
+     * the old segment is complete after this, and can be compacted in the background(journal_compact)
+     * @return false if the new segment can't be opened, or the old segment had failed(it misses ticks,
+     * take a snapshot before relying on the new segment)
+     */
+    bool rotate(const std::string& path){
+        utility::io::binary_writer uncommitted;
+        uncommitted.buffer().swap(active_.buffer());
+        uint64_t tick = tick_;
+
+        close();
+        bool old_failed = failed_;
+        bool ok = open(path);
+        tick_ = tick;
+        committed_tick_ = durable_tick_ = tick;
+        active_.buffer().swap(uncommitted.buffer());
+        return ok && !old_failed;
+    }
+
+    /**
+     * @brief flush the committed ticks and close the segment, the uncommitted records are dropped
+     */
+    void close(){
+        if (!file_){
+            return;
+        }
+
+        subscribe_events(0);
+        {
+            std::lock_guard<std::mutex> locker(mutex_);
+            stop_ = true;
+        }
+        pending_cond_.notify_one();
+        if (thread_.joinable()){
+            thread_.join();
+        }
+
+        fclose(file_);
+        file_ = nullptr;
+        active_.clear();
+    }
+
+    uint64_t tick() const{
+        return tick_;
+    }
+
+    uint64_t durable_tick(){
+        std::lock_guard<std::mutex> locker(mutex_);
+        return durable_tick_;
+    }
+
+    /** whether a write/fsync has failed, the journal stops advancing the durable tick */
+    bool failed(){
+        std::lock_guard<std::mutex> locker(mutex_);
+        return failed_;
+    }
+
+protected:
+    void writer_thread(){
+        std::vector<uint8_t> writing;
+        std::unique_lock<std::mutex> locker(mutex_);
+        while (true){
+            if (policy_ == journal_sync_per_tick){
+                pending_cond_.wait(locker, [this](){ return stop_ || flush_requested_ || !pending_.empty(); });
+            }
+            else{
+                pending_cond_.wait_for(locker, std::chrono::milliseconds(sync_interval_ms_),
+                    [this](){ return stop_ || flush_requested_; });
+            }
+            flush_requested_ = false;
+
+            if (failed_){
+                // nothing after the failed write can be replayed, drop it
+                pending_.clear();
+                if (stop_){
+                    break;
+                }
+                continue;
+            }
+
+            if (pending_.empty()){
+                durable_tick_ = committed_tick_;
+                durable_cond_.notify_all();
+                if (stop_){
+                    break;
+                }
+                continue;
+            }
+
+            writing.swap(pending_);
+            uint64_t tick = committed_tick_;
+            locker.unlock();
+
+            bool ok = detail::write_file(file_, &writing[0], writing.size());
+            writing.clear();
+
+            locker.lock();
+            if (ok){
+                durable_tick_ = tick;
+            }
+            else{
+                failed_ = true;
+            }
+            durable_cond_.notify_all();
+        }
+    }
+
+    void subscribe_events(int32_t mode){
+        entity_mgr_.subscribe_entity_create_event(&entity_created_subscriber_, mode);
+        entity_mgr_.subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+        entity_mgr_.subscribe_clear_event(&cleared_subscriber_, mode);
+        entity_mgr_.subscribe_entity_enable_event(&entity_enabled_subscriber_, mode);
+        entity_mgr_.subscribe_component_added_event(&component_added_subscriber_, mode);
+        entity_mgr_.subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+        entity_mgr_.subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        entity_mgr_.subscribe_component_change_event(&component_changed_subscriber_, mode);
+    }
+
+    void begin_record(){
+        // length and checksum, patched in end_record
+        record_begin_ = active_.size();
+        active_.write_u32(0);
+        active_.write_u32(0);
+    }
+
+    void end_record(){
+        std::size_t payload_begin = record_begin_ + 8;
+        std::size_t payload_size = active_.size() - payload_begin;
+        active_.patch_u32(record_begin_, (uint32_t)payload_size);
+        active_.patch_u32(record_begin_ + 4, detail::fnv1a(active_.data() + payload_begin, payload_size));
+    }
+
+    void write_entity_record(journal_op op, entity* en){
+        begin_record();
+        active_.write_u8((uint8_t)op);
+        active_.write_varint((uint64_t)en->id());
+        end_record();
+    }
+
+    void event_entity_created(entity* en){
+        write_entity_record(journal_op_create_entity, en);
+    }
+
+    void event_entity_removed(entity* en){
+        write_entity_record(journal_op_destory_entity, en);
+    }
+
+    void event_cleared(){
+        begin_record();
+        active_.write_u8(journal_op_clear);
+        end_record();
+    }
+
+    void event_entity_enabled(entity* en, bool enabled){
+        begin_record();
+        active_.write_u8(journal_op_set_enabled);
+        active_.write_varint((uint64_t)en->id());
+        active_.write_u8(enabled ? 1 : 0);
+        end_record();
+    }
+
+    void event_component_set(entity* en, component_id id, void* comp){
+        const component_codec* codec = registry_.find(id);
+        if (!codec){
+            return;
+        }
+
+        comp_writer_.clear();
+        codec->save(comp, comp_writer_);
+
+        begin_record();
+        active_.write_u8(journal_op_set_component);
+        active_.write_varint((uint64_t)en->id());
+        active_.write_varint(id);
+        active_.write_varint(comp_writer_.size());
+        active_.write_bytes(comp_writer_.data(), comp_writer_.size());
+        end_record();
+    }
+
+    void event_component_removed(entity* en, component_id id){
+        if (!registry_.find(id)){
+            return;
+        }
+
+        begin_record();
+        active_.write_u8(journal_op_remove_component);
+        active_.write_varint((uint64_t)en->id());
+        active_.write_varint(id);
+        end_record();
+    }
+};
+
+struct journal_replay_result
+{
+    bool        ok;                 // false if the journal can't be opened, the header is invalid or a committed record can't be applied
+    uint64_t    tick_count;         // the replayed committed ticks
+    uint64_t    record_count;
+    uint64_t    last_tick;
+    uint64_t    dropped_bytes;      // the torn tail and the uncommitted records
+
+    journal_replay_result()
+        : ok(false), tick_count(0), record_count(0), last_tick(0), dropped_bytes(0){}
+};
+
+class journal_replayer
+{
+protected:
+    const component_codec_registry&     registry_;
+
+public:
+    journal_replayer(const component_codec_registry& registry)
+        : registry_(registry){
+    }
+
+public:
+    /**
+     * @brief replay the committed ticks of the journal segment onto the context(the last snapshot loaded),
+     * the entity ids are kept, and the events are fired as usual
+     * the replay stops at the first committed record that can't be applied(result.ok is false),
+     * the records before it are applied
+     */
+    journal_replay_result replay(context& ctx, const std::string& path){
+        journal_replay_result result;
+        utility::io::mapped_file file;
+        if (!file.open(path)){
+            return result;
+        }
+
+        utility::io::binary_reader reader(file.data(), file.size());
+        uint32_t magic = 0, version = 0;
+        reader.read_u32(magic);
+        reader.read_u32(version);
+        if (reader.failed() || magic != journal_magic || version == 0 || version > journal_version){
+            return result;
+        }
+        result.ok = true;
+
+        // find the end of the last committed tick
+        std::size_t begin = reader.position();
+        std::size_t committed_end = begin;
+        while (!reader.eof()){
+            const uint8_t* payload = next_record(reader);
+            if (!payload){
+                break;
+            }
+            if (payload[0] == journal_op_commit_tick){
+                committed_end = reader.position();
+            }
+        }
+        result.dropped_bytes = file.size() - committed_end;
+
+        utility::io::binary_reader committed(file.data() + begin, committed_end - begin);
+        entity_manager& mgr = ctx.entity_admin;
+        while (!committed.eof()){
+            uint32_t payload_size = 0;
+            const uint8_t* payload = next_record(committed, &payload_size);
+            if (!payload){
+                result.ok = false;
+                break;
+            }
+            ++result.record_count;
+
+            utility::io::binary_reader record(payload, payload_size);
+            uint8_t op = 0;
+            uint64_t value = 0, comp_id = 0;
+            record.read_u8(op);
+            if (op == journal_op_clear){
+                mgr.clear();
+                continue;
+            }
+
+            record.read_varint(value);
+            if (op == journal_op_commit_tick){
+                result.last_tick = value;
+                ++result.tick_count;
+                continue;
+            }
+
+            int64_t entity_id = (int64_t)value;
+            if (op == journal_op_create_entity){
+                if (!mgr.has_entity(entity_id)){
+                    mgr.restore_entity(entity_id);
+                }
+                continue;
+            }
+
+            entity* en = mgr.get_entity(entity_id);
+            if (!en){
+                continue;
+            }
+
+            if (op == journal_op_destory_entity){
+                en->destory();
+                continue;
+            }
+
+            if (op == journal_op_set_enabled){
+                uint8_t enabled = 0;
+                if (!record.read_u8(enabled)){
+                    result.ok = false;
+                    break;
+                }
+                en->set_enabled(enabled != 0);
+                continue;
+            }
+
+            record.read_varint(comp_id);
+            if (op == journal_op_remove_component){
+                en->remove_component((component_id)comp_id);
+            }
+            else if (op == journal_op_set_component){
+                const component_codec* codec = registry_.find((component_id)comp_id);
+                uint64_t data_size = 0;
+                record.read_varint(data_size);
+                const uint8_t* data = record.fits(data_size) ? record.read_view((std::size_t)data_size) : nullptr;
+                if (!data){
+                    result.ok = false;
+                    break;
+                }
+
+                // the components that are not registered are skipped
+                if (codec){
+                    utility::io::binary_reader comp_reader(data, (std::size_t)data_size);
+                    if (!codec->assign(comp_reader, en)){
+                        result.ok = false;
+                        break;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+protected:
+    /**
+     * @brief read and verify the next record
+     * @return the payload, nullptr if the record is torn or corrupted
+     */
+    static const uint8_t* next_record(utility::io::binary_reader& reader, uint32_t* size = nullptr){
+        uint32_t payload_size = 0, checksum = 0;
+        if (!reader.read_u32(payload_size) || !reader.read_u32(checksum) || payload_size == 0){
+            return nullptr;
+        }
+        const uint8_t* payload = reader.read_view(payload_size);
+        if (!payload || detail::fnv1a(payload, payload_size) != checksum){
+            return nullptr;
+        }
+        if (size){
+            *size = payload_size;
+        }
+        return payload;
+    }
+};
+
+/**
+ * @brief fold a completed journal segment into the snapshot, on a private context,
+ * so it can run on a background thread while the simulation keeps writing the next segment
+ * @param snapshot_path: the last snapshot, may not exist for the first segment
+ */
+inline bool journal_compact(const component_codec_registry& registry, const std::string& snapshot_path,
+    const std::string& journal_path, const std::string& out_snapshot_path){
+    context ctx;
+    snapshot snap(registry);
+
+    FILE* f = fopen(snapshot_path.c_str(), "rb");
+    if (f){
+        fclose(f);
+        if (!snap.load(ctx, snapshot_path)){
+            return false;
+        }
+    }
+
+    journal_replayer replayer(registry);
+    if (!replayer.replay(ctx, journal_path).ok){
+        return false;
+    }
+    return snap.save(ctx, out_snapshot_path);
+}
+}
+
+#endif
\ No newline at end of file
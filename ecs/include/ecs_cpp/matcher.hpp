@@ -17,10 +17,47 @@
 #include <vector>
 #include <typeindex>
 #include <functional>
+#include <algorithm>
 #include <memory>
 
 namespace ecs_cpp
 {
+template<typename... Components> struct all_of;
+template<typename... Components> struct any_of;
+template<typename... Components> struct none_of;
+
+/**
+ * a composite type-level matcher, built fluently from the parts:
+ *  all_of<A, B>().any_of<C, D>().none_of<E>()
+ * used with entity_manager::get_group(expr) / entity_manager::query(expr, f)
+ */
+template<typename... Parts>
+struct matcher_expr
+{
+    template<typename... Components>
+    matcher_expr<Parts..., ecs_cpp::all_of<Components...>> all_of() const{
+        return matcher_expr<Parts..., ecs_cpp::all_of<Components...>>();
+    }
+
+    template<typename... Components>
+    matcher_expr<Parts..., ecs_cpp::any_of<Components...>> any_of() const{
+        return matcher_expr<Parts..., ecs_cpp::any_of<Components...>>();
+    }
+
+    template<typename... Components>
+    matcher_expr<Parts..., ecs_cpp::none_of<Components...>> none_of() const{
+        return matcher_expr<Parts..., ecs_cpp::none_of<Components...>>();
+    }
+};
+
+/**
+ * the type-level matcher parts, matcher::of<all_of<A, B>, none_of<C>>(),
+ * entity_manager::get_group<all_of<A, B>, none_of<C>>()
+ */
+template<typename... Components> struct all_of : matcher_expr<all_of<Components...>>{};
+template<typename... Components> struct any_of : matcher_expr<any_of<Components...>>{};
+template<typename... Components> struct none_of : matcher_expr<none_of<Components...>>{};
+
 class entity;
 class matcher
 {
@@ -33,51 +70,93 @@ protected:
     component_type_list none_of_component_type_list_;
     uint32_t            hash_code_;
 
+    /** the lists as signature masks, used when all the types have a signature bit */
+    component_signature all_of_mask_;
+    component_signature any_of_mask_;
+    component_signature none_of_mask_;
+    bool                masks_complete_;
+
 public:
     template<typename ... Components>
     static matcher::ptr all_of(){
-        matcher::ptr mther = std::make_shared<matcher>();
-        std::vector<std::function<void()>> funs = { std::bind(&matcher::add_to_allof_list<Components>, mther.get())... };
-        for (auto& f : funs){
-            f();
-        }
-        mther->calc_hash_code();
-        return mther;
+        return of<ecs_cpp::all_of<Components...>>();
     }
 
     template<typename ... Components>
     static matcher::ptr any_of(){
-        matcher::ptr mther = std::make_shared<matcher>();
-        std::vector<std::function<void()>> funs = { std::bind(&matcher::add_to_anyof_list<Components>, mther.get())... };
-        for (auto& f : funs){
-            f();
-        }
-        mther->calc_hash_code();
-        return mther;
+        return of<ecs_cpp::any_of<Components...>>();
     }
 
     template<typename ... Components>
     static matcher::ptr none_of(){
-        matcher::ptr mther = std::make_shared<matcher>();
-        std::vector<std::function<void()>> funs = { std::bind(&matcher::add_to_noneof_list<Components>, mther.get())... };
-        for (auto& f : funs){
-            f();
-        }
-        mther->calc_hash_code();
+        return of<ecs_cpp::none_of<Components...>>();
+    }
+
+    /**
+     * @brief the matcher of the type-level parts, built once per parts pack and shared(a matcher is immutable)
+     */
+    template<typename ... Parts>
+    static matcher::ptr of(){
+        static const matcher::ptr mther = build<Parts...>();
         return mther;
     }
 
+    template<typename ... Parts>
+    static matcher::ptr of(matcher_expr<Parts...>){
+        return of<Parts...>();
+    }
+
 public:
-    matcher() : hash_code_(0){}
+    matcher() : hash_code_(0), masks_complete_(true){}
     ~matcher(){}
 
 public:
     bool matches(entity* en){
+        if (masks_complete_){
+            const component_signature& sig = en->signature();
+            return ((sig & all_of_mask_) == all_of_mask_ &&
+                    (any_of_mask_.none() || (sig & any_of_mask_).any()) &&
+                    (sig & none_of_mask_).none());
+        }
+
         return ((all_of_component_type_list_.empty() || en->has_components(all_of_component_type_list_)) &&
                 (any_of_component_type_list_.empty() || en->has_any_components(any_of_component_type_list_)) &&
                 (none_of_component_type_list_.empty() || en->has_none_components(none_of_component_type_list_)));
     }
 
+    /**
+     * @brief whether the component type is in any of the lists(may change the match result)
+     */
+    bool involves(component_id id) const{
+        return std::find(all_of_component_type_list_.begin(), all_of_component_type_list_.end(), id) != all_of_component_type_list_.end() ||
+               std::find(any_of_component_type_list_.begin(), any_of_component_type_list_.end(), id) != any_of_component_type_list_.end() ||
+               std::find(none_of_component_type_list_.begin(), none_of_component_type_list_.end(), id) != none_of_component_type_list_.end();
+    }
+
+    /**
+     * @brief whether every entity matched by that is also matched by this,
+     * a sufficient test(this has no any-list, and its all/none-lists are subsets of that's)
+     */
+    bool covers(const matcher& that) const{
+        return any_of_component_type_list_.empty() &&
+               std::includes(that.all_of_component_type_list_.begin(), that.all_of_component_type_list_.end(),
+                   all_of_component_type_list_.begin(), all_of_component_type_list_.end()) &&
+               std::includes(that.none_of_component_type_list_.begin(), that.none_of_component_type_list_.end(),
+                   none_of_component_type_list_.begin(), none_of_component_type_list_.end());
+    }
+
+    const component_type_list& all_of_component_types() const{
+        return all_of_component_type_list_;
+    }
+
+    const component_type_list& any_of_component_types() const{
+        return any_of_component_type_list_;
+    }
+
+    const component_type_list& none_of_component_types() const{
+        return none_of_component_type_list_;
+    }
+
     uint32_t hash_code() const { 
         return hash_code_; 
     }
@@ -85,11 +164,20 @@ public:
     bool operator ==(const matcher& that) const{
         return (hash_code() == that.hash_code() && 
                 check_component_vector_equal(all_of_component_type_list_, that.all_of_component_type_list_) && 
-                check_component_vector_equal(any_of_component_type_list_, that.all_of_component_type_list_) && 
+                check_component_vector_equal(any_of_component_type_list_, that.any_of_component_type_list_) && 
                 check_component_vector_equal(none_of_component_type_list_, that.none_of_component_type_list_));
     }
 
 protected:
+    template<typename ... Parts>
+    static matcher::ptr build(){
+        matcher::ptr mther = std::make_shared<matcher>();
+        int dummy[] = { 0, (mther->add_part(Parts()), 0)... };
+        (void)dummy;
+        mther->calc_hash_code();
+        return mther;
+    }
+
     static bool check_component_vector_equal(const component_type_list& list1, const component_type_list& list2){
         if (list1.size() != list2.size()){
             return false;
@@ -104,6 +192,11 @@ protected:
     }
 
     void calc_hash_code(){
+        // the lists are kept sorted, so the declaration order doesn't matter for the equality
+        std::sort(all_of_component_type_list_.begin(), all_of_component_type_list_.end());
+        std::sort(any_of_component_type_list_.begin(), any_of_component_type_list_.end());
+        std::sort(none_of_component_type_list_.begin(), none_of_component_type_list_.end());
+
         uint32_t hash = typeid(matcher).hash_code();
         hash = apply_hash(hash, all_of_component_type_list_, 3, 53);
         hash = apply_hash(hash, any_of_component_type_list_, 307, 367);
@@ -117,6 +210,7 @@ protected:
         auto iter = std::find(all_of_component_type_list_.begin(), all_of_component_type_list_.end(), type_id);
         if (iter == all_of_component_type_list_.end()){
             all_of_component_type_list_.push_back(type_id);
+            add_to_mask<C>(all_of_mask_);
         }
     }
 
@@ -126,6 +220,7 @@ protected:
         auto iter = std::find(any_of_component_type_list_.begin(), any_of_component_type_list_.end(), type_id);
         if (iter == any_of_component_type_list_.end()){
             any_of_component_type_list_.push_back(type_id);
+            add_to_mask<C>(any_of_mask_);
         }
     }
 
@@ -135,6 +230,36 @@ protected:
         auto iter = std::find(none_of_component_type_list_.begin(), none_of_component_type_list_.end(), type_id);
         if (iter == none_of_component_type_list_.end()){
             none_of_component_type_list_.push_back(type_id);
+            add_to_mask<C>(none_of_mask_);
+        }
+    }
+
+    template<typename ... Components>
+    void add_part(ecs_cpp::all_of<Components...>){
+        int dummy[] = { 0, (add_to_allof_list<Components>(), 0)... };
+        (void)dummy;
+    }
+
+    template<typename ... Components>
+    void add_part(ecs_cpp::any_of<Components...>){
+        int dummy[] = { 0, (add_to_anyof_list<Components>(), 0)... };
+        (void)dummy;
+    }
+
+    template<typename ... Components>
+    void add_part(ecs_cpp::none_of<Components...>){
+        int dummy[] = { 0, (add_to_noneof_list<Components>(), 0)... };
+        (void)dummy;
+    }
+
+    template<typename C>
+    void add_to_mask(component_signature& mask){
+        uint32_t bit = component_type_registry::bit<C>();
+        if (bit != invalid_component_bit){
+            mask.set(bit);
+        }
+        else{
+            masks_complete_ = false;
         }
     }
 
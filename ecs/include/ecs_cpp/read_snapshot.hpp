@@ -0,0 +1,307 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: read_snapshot.hpp
+ *
+ * the consistent read-only views of a component type for the reader threads(render, network, telemetry)
+ *
+ *  read_snapshot_publisher<position> positions(ctx.entity_admin);
+ *  // simulation thread, at the end of each tick
+ *  positions.publish();
+ *  // any reader thread, lock free iteration of the last published tick
+ *  read_snapshot<position>::ptr snap = positions.acquire();
+ *  snap->for_each([](int64_t entity_id, const position& pos){ ... });
+ *
+ * the publisher mirrors the component into <entity id, value> rows kept in fixed size chunks,
+ * following the manager level component events. a snapshot shares the chunks, and the simulation
+ * copies a chunk on the first write after it's published(copy-on-write), so the publish cost is the
+ * changed chunks plus a pointer per chunk, not a deep copy of the world.
+ * the component written in place must be marked changed(entity::mark_changed) to be seen,
+ * the disabled entitys are not mirrored(as the groups skip them), their rows come back when enabled
+ */
+
+#ifndef __ydk_ecs_read_snapshot_hpp__
+#define __ydk_ecs_read_snapshot_hpp__
+
+#include <ecs_cpp/entity_manager.hpp>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace ecs_cpp
+{
+/**
+ * @brief the immutable view of a component type at a tick, safe to read from any thread
+ */
+template<typename C>
+class read_snapshot
+{
+public:
+    typedef std::shared_ptr<const read_snapshot> ptr;
+
+    struct row_t{
+        int64_t     entity_id;
+        C           value;
+    };
+
+    struct chunk_t{
+        std::vector<row_t>  rows;
+    };
+
+    typedef std::shared_ptr<const chunk_t> chunk_ptr;
+
+protected:
+    uint64_t                tick_;
+    uint32_t                row_count_;
+    std::vector<chunk_ptr>  chunks_;
+
+public:
+    read_snapshot(uint64_t tick, uint32_t row_count, std::vector<chunk_ptr>&& chunks)
+        : tick_(tick)
+        , row_count_(row_count)
+        , chunks_(std::move(chunks))
+    {
+    }
+
+public:
+    /** the publish count when it's published */
+    uint64_t tick() const{
+        return tick_;
+    }
+
+    /** the count of the entitys that have the component */
+    uint32_t size() const{
+        return row_count_;
+    }
+
+    /** the chunks are shared by the snapshots until they are changed */
+    const std::vector<chunk_ptr>& chunks() const{
+        return chunks_;
+    }
+
+    /**
+     * @brief visit the rows, f(int64_t entity_id, const C&)
+     */
+    template<typename F>
+    void for_each(F f) const{
+        for (auto& chunk : chunks_){
+            for (auto& row : chunk->rows){
+                f(row.entity_id, row.value);
+            }
+        }
+    }
+};
+
+template<typename C>
+class read_snapshot_publisher
+{
+public:
+    typedef read_snapshot<C>                    snapshot_type;
+    typedef typename snapshot_type::row_t       row_t;
+    typedef typename snapshot_type::chunk_t     chunk_t;
+
+protected:
+    entity_manager&         entity_mgr_;
+    component_id            component_id_;
+    uint32_t                chunk_rows_;
+    uint64_t                tick_;
+
+    /** the rows of the simulation, a chunk is shared with the published snapshots until it's written */
+    std::vector<std::shared_ptr<chunk_t>>   chunks_;
+    uint32_t                                row_count_;
+
+    /** <entity, row>, and <row, entity> for the swap remove */
+    std::unordered_map<entity*, uint32_t>   rows_;
+    std::vector<entity*>                    row_entitys_;
+
+    /** the last published snapshot, accessed by std::atomic_load/atomic_store */
+    typename snapshot_type::ptr             published_;
+
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, bool> entity_enabled_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+public:
+    /**
+     * @param chunk_rows - the rows per chunk, the copy-on-write granularity
+     */
+    read_snapshot_publisher(entity_manager& entity_mgr, uint32_t chunk_rows = 256)
+        : entity_mgr_(entity_mgr)
+        , component_id_((component_id)typeid(C).hash_code())
+        , chunk_rows_(chunk_rows > 0 ? chunk_rows : 1)
+        , tick_(0)
+        , row_count_(0)
+    {
+        static_assert(!is_tag_component<C>::value, "the tag component has no value to read");
+
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_cleared, this));
+        entity_enabled_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_entity_enabled, this, std::placeholders::_1, std::placeholders::_2));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_component_set, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_component_set, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_4));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_component_removed, this, std::placeholders::_1, std::placeholders::_2));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&read_snapshot_publisher::event_component_set, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+        subscribe_events(1);
+        entity_mgr_.for_each_entity([this](entity* en){
+            C* comp = en->get_component<C>();
+            if (comp && en->enabled()){
+                set_row(en, *comp);
+            }
+        });
+        publish();
+    }
+
+    ~read_snapshot_publisher(){
+        subscribe_events(0);
+    }
+
+    read_snapshot_publisher(const read_snapshot_publisher&) = delete;
+    read_snapshot_publisher& operator = (const read_snapshot_publisher&) = delete;
+
+public:
+    /**
+     * @brief publish the current state as the next snapshot, called by the simulation thread
+     * @return the published snapshot
+     */
+    typename snapshot_type::ptr publish(){
+        std::vector<typename snapshot_type::chunk_ptr> chunks(chunks_.begin(), chunks_.end());
+        typename snapshot_type::ptr snap = std::make_shared<snapshot_type>(++tick_, row_count_, std::move(chunks));
+        std::atomic_store(&published_, snap);
+        return snap;
+    }
+
+    /**
+     * @brief the last published snapshot, called by any reader thread,
+     * the snapshot stays valid(and unchanged) as long as it's held
+     */
+    typename snapshot_type::ptr acquire() const{
+        return std::atomic_load(&published_);
+    }
+
+    uint32_t size() const{
+        return row_count_;
+    }
+
+protected:
+    void subscribe_events(int32_t mode){
+        entity_mgr_.subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+        entity_mgr_.subscribe_clear_event(&cleared_subscriber_, mode);
+        entity_mgr_.subscribe_entity_enable_event(&entity_enabled_subscriber_, mode);
+        entity_mgr_.subscribe_component_added_event(&component_added_subscriber_, mode);
+        entity_mgr_.subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+        entity_mgr_.subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        entity_mgr_.subscribe_component_change_event(&component_changed_subscriber_, mode);
+    }
+
+    /**
+     * @brief the chunk to write, copied first if a published snapshot still shares it
+     * the readers only reach a chunk through the atomic_load of published_(paired with the atomic_store
+     * of publish), and published_ holds every chunk of the last publish until the next one, so such a
+     * chunk is always shared. a chunk with a use count of 1 was created or copied after the last publish
+     * and has never been seen by a reader
+     */
+    chunk_t& writable_chunk(uint32_t index){
+        std::shared_ptr<chunk_t>& chunk = chunks_[index];
+        if (chunk.use_count() > 1){
+            chunk = std::make_shared<chunk_t>(*chunk);
+        }
+        return *chunk;
+    }
+
+    void set_row(entity* en, const C& value){
+        auto iter = rows_.find(en);
+        if (iter != rows_.end()){
+            writable_chunk(iter->second / chunk_rows_).rows[iter->second % chunk_rows_].value = value;
+            return;
+        }
+
+        if (row_count_ % chunk_rows_ == 0){
+            chunks_.push_back(std::make_shared<chunk_t>());
+            chunks_.back()->rows.reserve(chunk_rows_);
+        }
+        row_t row = { en->id(), value };
+        writable_chunk(row_count_ / chunk_rows_).rows.push_back(row);
+        rows_.insert(std::make_pair(en, row_count_));
+        row_entitys_.push_back(en);
+        ++row_count_;
+    }
+
+    /** swap remove, the last row is moved to the hole */
+    void erase_row(entity* en){
+        auto iter = rows_.find(en);
+        if (iter == rows_.end()){
+            return;
+        }
+
+        uint32_t row = iter->second;
+        uint32_t last = row_count_ - 1;
+        rows_.erase(iter);
+        if (row != last){
+            const row_t& last_row = chunks_[last / chunk_rows_]->rows[last % chunk_rows_];
+            row_t moved = last_row;
+            writable_chunk(row / chunk_rows_).rows[row % chunk_rows_] = moved;
+
+            entity* moved_en = row_entitys_[last];
+            row_entitys_[row] = moved_en;
+            rows_[moved_en] = row;
+        }
+
+        writable_chunk(last / chunk_rows_).rows.pop_back();
+        if (last % chunk_rows_ == 0){
+            chunks_.pop_back();
+        }
+        row_entitys_.pop_back();
+        --row_count_;
+    }
+
+    void event_entity_removed(entity* en){
+        erase_row(en);
+    }
+
+    void event_cleared(){
+        chunks_.clear();
+        rows_.clear();
+        row_entitys_.clear();
+        row_count_ = 0;
+    }
+
+    void event_entity_enabled(entity* en, bool enabled){
+        if (!enabled){
+            erase_row(en);
+            return;
+        }
+
+        C* comp = en->get_component<C>();
+        if (comp){
+            set_row(en, *comp);
+        }
+    }
+
+    void event_component_set(entity* en, component_id id, void* comp){
+        if (id == component_id_ && en->enabled()){
+            set_row(en, *static_cast<const C*>(comp));
+        }
+    }
+
+    void event_component_removed(entity* en, component_id id){
+        if (id == component_id_){
+            erase_row(en);
+        }
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,584 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: replication.hpp
+ *
+ * per tick delta snapshots for the state replication
+ *
+ * the encoder collects the created/destoryed entitys and the changed components from the events,
+ * and encodes them against the last sent state(the baseline), a changed component is sent as the
+ * changed byte runs of its serialized data. the decoder applies the deltas to another context.
+ * the deltas must be applied in order, every delta is encoded against the previous one.
+ *
+ * delta format(all the integers are varints):
+ *  tick
+ *  destoryed_count, (entity_id - prev_entity_id) * destoryed_count
+ *  created_count,   (entity_id - prev_entity_id) * created_count
+ *  enable_count,    (entity_id - prev_entity_id, enabled(u8)) * enable_count
+ *  change_count,    change * change_count
+ *      change: entity_id - prev_entity_id, component_id, kind(u8)
+ *          full:   size, bytes
+ *          patch:  run_count, (skip, length, bytes) * run_count
+ *          remove: -
+ */
+
+#ifndef __ydk_ecs_replication_hpp__
+#define __ydk_ecs_replication_hpp__
+
+#include <ecs_cpp/context.hpp>
+#include <ecs_cpp/serialization.hpp>
+#include <utility/io/binary_stream.hpp>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ecs_cpp
+{
+enum delta_change_kind
+{
+    delta_change_full   = 0,
+    delta_change_patch  = 1,
+    delta_change_remove = 2,
+};
+
+struct delta_stats
+{
+    uint64_t    tick;
+    uint32_t    created_count;
+    uint32_t    destoryed_count;
+    uint32_t    enable_count;
+    uint32_t    full_count;
+    uint32_t    patch_count;
+    uint32_t    remove_count;
+    uint64_t    byte_count;
+
+    delta_stats()
+        : tick(0), created_count(0), destoryed_count(0), enable_count(0), full_count(0)
+        , patch_count(0), remove_count(0), byte_count(0){}
+};
+
+namespace detail
+{
+    /** <component id, the serialized data> of an entity, an entity has only a few components */
+    typedef std::vector<std::pair<component_id, std::vector<uint8_t>>> entity_baseline;
+
+    inline std::vector<uint8_t>* find_baseline(entity_baseline& baseline, component_id id){
+        for (auto& kv : baseline){
+            if (kv.first == id){
+                return &kv.second;
+            }
+        }
+        return nullptr;
+    }
+
+    inline void erase_baseline(entity_baseline& baseline, component_id id){
+        for (auto iter = baseline.begin(); iter != baseline.end(); ++iter){
+            if (iter->first == id){
+                baseline.erase(iter);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief write the changed byte runs of data against base(same size),
+     * the runs closer than 4 bytes are merged
+     * @return the run count, 0 if nothing changed
+     */
+    inline uint32_t write_patch(const std::vector<uint8_t>& base, const std::vector<uint8_t>& data,
+        utility::io::binary_writer& writer){
+        static const std::size_t merge_gap = 4;
+
+        std::vector<std::pair<std::size_t, std::size_t>> runs;  // <begin, end>
+        std::size_t i = 0, n = data.size();
+        while (i < n){
+            if (base[i] == data[i]){
+                ++i;
+                continue;
+            }
+            std::size_t begin = i, end = i + 1;
+            for (std::size_t j = end; j < n && j < end + merge_gap; ++j){
+                if (base[j] != data[j]){
+                    end = j + 1;
+                }
+            }
+            runs.push_back(std::make_pair(begin, end));
+            i = end;
+        }
+
+        if (runs.empty()){
+            return 0;
+        }
+
+        writer.write_varint(runs.size());
+        std::size_t prev_end = 0;
+        for (auto& run : runs){
+            writer.write_varint(run.first - prev_end);
+            writer.write_varint(run.second - run.first);
+            writer.write_bytes(&data[run.first], run.second - run.first);
+            prev_end = run.second;
+        }
+        return runs.size();
+    }
+
+    inline bool apply_patch(utility::io::binary_reader& reader, std::vector<uint8_t>& data){
+        uint64_t run_count = 0;
+        if (!reader.read_varint(run_count)){
+            return false;
+        }
+
+        std::size_t pos = 0;
+        for (uint64_t r = 0; r < run_count; ++r){
+            uint64_t skip = 0, length = 0;
+            reader.read_varint(skip);
+            reader.read_varint(length);
+            if (reader.failed() || skip > data.size() - pos){
+                return false;
+            }
+            pos += (std::size_t)skip;
+            if (length > data.size() - pos || !reader.read_bytes(&data[pos], (std::size_t)length)){
+                return false;
+            }
+            pos += (std::size_t)length;
+        }
+        return true;
+    }
+}
+
+class delta_encoder
+{
+protected:
+    entity_manager&                     entity_mgr_;
+    const component_codec_registry&     registry_;
+    uint64_t                            tick_;
+    delta_stats                         stats_;
+
+    /** the changes of the current tick */
+    std::unordered_set<int64_t>         created_;
+    std::unordered_set<int64_t>         destoryed_;
+    /** <entity id, enabled> of the entitys enabled/disabled in the tick */
+    std::unordered_map<int64_t, bool>   enabled_;
+    /** <entity id, <entity, changed component ids>> */
+    std::unordered_map<int64_t, std::pair<entity*, std::vector<component_id>>> dirty_;
+
+    /** <entity id, the last sent state> */
+    std::unordered_map<int64_t, detail::entity_baseline> baseline_;
+
+    event_subscriber<entity*>   entity_created_subscriber_;
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, bool> entity_enabled_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+public:
+    delta_encoder(entity_manager& entity_mgr, const component_codec_registry& registry)
+        : entity_mgr_(entity_mgr)
+        , registry_(registry)
+        , tick_(0)
+    {
+        entity_created_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_entity_created, this, std::placeholders::_1));
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_cleared, this));
+        entity_enabled_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_entity_enabled, this, std::placeholders::_1, std::placeholders::_2));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_component_changed, this, std::placeholders::_1, std::placeholders::_2));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_component_changed, this, std::placeholders::_1, std::placeholders::_2));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_component_changed, this, std::placeholders::_1, std::placeholders::_2));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&delta_encoder::event_component_changed, this, std::placeholders::_1, std::placeholders::_2));
+
+        subscribe_events(1);
+
+        // the existing entitys are sent in the first delta
+        entity_mgr_.for_each_entity([this](entity* en){
+            event_entity_created(en);
+            if (!en->enabled()){
+                event_entity_enabled(en, false);
+            }
+            en->for_each_component([this, en](component_id id, void* /*comp*/){
+                event_component_changed(en, id);
+            });
+        });
+    }
+
+    ~delta_encoder(){
+        subscribe_events(0);
+    }
+
+public:
+    /**
+     * @brief encode the changes since the last encode, and update the baseline
+     */
+    void encode(utility::io::binary_writer& writer){
+        stats_ = delta_stats();
+        stats_.tick = ++tick_;
+        std::size_t begin = writer.size();
+
+        writer.write_varint(tick_);
+        write_ids(destoryed_, writer);
+        write_ids(created_, writer);
+        write_enabled(writer);
+        stats_.destoryed_count = destoryed_.size();
+        stats_.created_count = created_.size();
+        stats_.enable_count = enabled_.size();
+
+        // every entity known by the peer has a baseline, even without a component to send
+        for (int64_t id : created_){
+            baseline_.insert(std::make_pair(id, detail::entity_baseline()));
+        }
+
+        std::vector<int64_t> dirty_ids;
+        dirty_ids.reserve(dirty_.size());
+        for (auto& kv : dirty_){
+            dirty_ids.push_back(kv.first);
+        }
+        std::sort(dirty_ids.begin(), dirty_ids.end());
+
+        // the change count is unknown until the end, encode the changes to a temp buffer
+        utility::io::binary_writer changes;
+        uint64_t change_count = 0;
+        int64_t prev_id = 0;
+        std::vector<uint8_t> data;
+        utility::io::binary_writer comp_writer;
+        utility::io::binary_writer patch_writer;
+        for (int64_t id : dirty_ids){
+            auto& dirty = dirty_[id];
+            entity* en = dirty.first;
+            detail::entity_baseline& baseline = baseline_[id];
+            std::sort(dirty.second.begin(), dirty.second.end());
+
+            for (component_id comp_id : dirty.second){
+                std::vector<uint8_t>* base = detail::find_baseline(baseline, comp_id);
+                void* comp = en->get_component(comp_id);
+                if (!en->has_component(comp_id)){
+                    if (base){
+                        write_change_header(changes, id, prev_id, comp_id, delta_change_remove);
+                        detail::erase_baseline(baseline, comp_id);
+                        ++change_count;
+                        ++stats_.remove_count;
+                    }
+                    continue;
+                }
+
+                comp_writer.clear();
+                registry_.find(comp_id)->save(comp, comp_writer);
+                data.assign(comp_writer.data(), comp_writer.data() + comp_writer.size());
+
+                if (base && base->size() == data.size()){
+                    patch_writer.clear();
+                    if (detail::write_patch(*base, data, patch_writer) == 0){
+                        continue;
+                    }
+                    write_change_header(changes, id, prev_id, comp_id, delta_change_patch);
+                    changes.write_bytes(patch_writer.data(), patch_writer.size());
+                    ++stats_.patch_count;
+                }
+                else{
+                    write_change_header(changes, id, prev_id, comp_id, delta_change_full);
+                    changes.write_varint(data.size());
+                    changes.write_bytes(data.empty() ? nullptr : &data[0], data.size());
+                    ++stats_.full_count;
+                }
+                ++change_count;
+
+                if (base){
+                    base->swap(data);
+                }
+                else{
+                    baseline.push_back(std::make_pair(comp_id, data));
+                }
+            }
+        }
+
+        writer.write_varint(change_count);
+        writer.write_bytes(changes.data(), changes.size());
+
+        created_.clear();
+        destoryed_.clear();
+        enabled_.clear();
+        dirty_.clear();
+
+        stats_.byte_count = writer.size() - begin;
+    }
+
+    /** the stats of the last encode */
+    const delta_stats& stats() const{
+        return stats_;
+    }
+
+protected:
+    void subscribe_events(int32_t mode){
+        entity_mgr_.subscribe_entity_create_event(&entity_created_subscriber_, mode);
+        entity_mgr_.subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+        entity_mgr_.subscribe_clear_event(&cleared_subscriber_, mode);
+        entity_mgr_.subscribe_entity_enable_event(&entity_enabled_subscriber_, mode);
+        entity_mgr_.subscribe_component_added_event(&component_added_subscriber_, mode);
+        entity_mgr_.subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+        entity_mgr_.subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        entity_mgr_.subscribe_component_change_event(&component_changed_subscriber_, mode);
+    }
+
+    static void write_ids(const std::unordered_set<int64_t>& ids, utility::io::binary_writer& writer){
+        std::vector<int64_t> sorted_ids(ids.begin(), ids.end());
+        std::sort(sorted_ids.begin(), sorted_ids.end());
+
+        writer.write_varint(sorted_ids.size());
+        int64_t prev_id = 0;
+        for (int64_t id : sorted_ids){
+            writer.write_varint((uint64_t)(id - prev_id));
+            prev_id = id;
+        }
+    }
+
+    void write_enabled(utility::io::binary_writer& writer){
+        std::vector<int64_t> sorted_ids;
+        sorted_ids.reserve(enabled_.size());
+        for (auto& kv : enabled_){
+            sorted_ids.push_back(kv.first);
+        }
+        std::sort(sorted_ids.begin(), sorted_ids.end());
+
+        writer.write_varint(sorted_ids.size());
+        int64_t prev_id = 0;
+        for (int64_t id : sorted_ids){
+            writer.write_varint((uint64_t)(id - prev_id));
+            writer.write_u8(enabled_[id] ? 1 : 0);
+            prev_id = id;
+        }
+    }
+
+    static void write_change_header(utility::io::binary_writer& writer, int64_t id, int64_t& prev_id,
+        component_id comp_id, delta_change_kind kind){
+        writer.write_varint((uint64_t)(id - prev_id));
+        writer.write_varint(comp_id);
+        writer.write_u8((uint8_t)kind);
+        prev_id = id;
+    }
+
+    void event_entity_created(entity* en){
+        created_.insert(en->id());
+    }
+
+    void event_entity_removed(entity* en){
+        int64_t id = en->id();
+        dirty_.erase(id);
+        enabled_.erase(id);
+        baseline_.erase(id);
+
+        // created and destoryed in the same tick, the peer never knows it
+        if (created_.erase(id) == 0){
+            destoryed_.insert(id);
+        }
+    }
+
+    /** all the entitys are destoryed in bulk, the peer drops the ones it knows */
+    void event_cleared(){
+        for (auto& baseline_kv : baseline_){
+            destoryed_.insert(baseline_kv.first);
+        }
+        baseline_.clear();
+        created_.clear();
+        enabled_.clear();
+        dirty_.clear();
+    }
+
+    /** only the last state of the tick is sent */
+    void event_entity_enabled(entity* en, bool enabled){
+        enabled_[en->id()] = enabled;
+    }
+
+    void event_component_changed(entity* en, component_id id){
+        if (!registry_.find(id)){
+            return;
+        }
+
+        auto& dirty = dirty_[en->id()];
+        dirty.first = en;
+        if (std::find(dirty.second.begin(), dirty.second.end(), id) == dirty.second.end()){
+            dirty.second.push_back(id);
+        }
+    }
+};
+
+class delta_decoder
+{
+protected:
+    context&                            ctx_;
+    const component_codec_registry&     registry_;
+    uint64_t                            tick_;
+
+    /** <remote entity id, local entity> */
+    std::unordered_map<int64_t, entity*> entitys_;
+
+    /** <remote entity id, the last received state> */
+    std::unordered_map<int64_t, detail::entity_baseline> baseline_;
+
+public:
+    delta_decoder(context& ctx, const component_codec_registry& registry)
+        : ctx_(ctx)
+        , registry_(registry)
+        , tick_(0){
+    }
+
+public:
+    /**
+     * @brief apply a delta, the entity/component events are fired in the context
+     * @return false if the delta is corrupted or out of order, the tick is not advanced.
+     * a delta that fails halfway may have been partially applied, the world must be reset(reset())
+     * and resynced from a full state(the first delta of a new encoder)
+     */
+    bool apply(const uint8_t* data, std::size_t size){
+        utility::io::binary_reader reader(data, size);
+
+        uint64_t tick = 0;
+        if (!reader.read_varint(tick) || tick != tick_ + 1){
+            return false;
+        }
+        if (!apply_changes(reader)){
+            return false;
+        }
+        tick_ = tick;
+        return true;
+    }
+
+    /**
+     * @brief destory the replicated entitys and forget the baselines, the next delta must be tick 1
+     */
+    void reset(){
+        for (auto& pair : entitys_){
+            pair.second->destory();
+        }
+        entitys_.clear();
+        baseline_.clear();
+        tick_ = 0;
+    }
+
+    /** the local entity of the remote entity id */
+    entity* local_entity(int64_t remote_id){
+        auto iter = entitys_.find(remote_id);
+        if (iter != entitys_.end()){
+            return iter->second;
+        }
+        return nullptr;
+    }
+
+    uint64_t tick() const{
+        return tick_;
+    }
+
+protected:
+    bool apply_changes(utility::io::binary_reader& reader){
+        uint64_t count = 0;
+        int64_t id = 0;
+        reader.read_varint(count);
+        for (uint64_t i = 0; i < count && !reader.failed(); ++i){
+            id += read_id_delta(reader);
+            auto iter = entitys_.find(id);
+            if (iter != entitys_.end()){
+                iter->second->destory();
+                entitys_.erase(iter);
+            }
+            baseline_.erase(id);
+        }
+
+        count = 0;
+        id = 0;
+        reader.read_varint(count);
+        for (uint64_t i = 0; i < count && !reader.failed(); ++i){
+            id += read_id_delta(reader);
+            entitys_[id] = ctx_.entity_admin.create_entity();
+        }
+
+        count = 0;
+        id = 0;
+        reader.read_varint(count);
+        for (uint64_t i = 0; i < count; ++i){
+            uint8_t enabled = 0;
+            id += read_id_delta(reader);
+            reader.read_u8(enabled);
+            auto iter = entitys_.find(id);
+            if (reader.failed() || iter == entitys_.end()){
+                return false;
+            }
+            iter->second->set_enabled(enabled != 0);
+        }
+
+        count = 0;
+        id = 0;
+        reader.read_varint(count);
+        std::vector<uint8_t> full;
+        for (uint64_t i = 0; i < count; ++i){
+            uint64_t comp_id = 0;
+            uint8_t kind = 0;
+            id += read_id_delta(reader);
+            reader.read_varint(comp_id);
+            reader.read_u8(kind);
+            if (reader.failed()){
+                return false;
+            }
+
+            auto iter = entitys_.find(id);
+            const component_codec* codec = registry_.find((component_id)comp_id);
+            if (iter == entitys_.end() || !codec){
+                return false;
+            }
+
+            entity* en = iter->second;
+            detail::entity_baseline& baseline = baseline_[id];
+            std::vector<uint8_t>* base = detail::find_baseline(baseline, (component_id)comp_id);
+            if (kind == delta_change_remove){
+                en->remove_component((component_id)comp_id);
+                detail::erase_baseline(baseline, (component_id)comp_id);
+                continue;
+            }
+
+            if (kind == delta_change_full){
+                uint64_t data_size = 0;
+                reader.read_varint(data_size);
+                if (!reader.fits(data_size)){
+                    return false;
+                }
+                const uint8_t* p = reader.read_view((std::size_t)data_size);
+                if (!p){
+                    return false;
+                }
+                full.assign(p, p + data_size);
+                if (base){
+                    base->swap(full);
+                }
+                else{
+                    baseline.push_back(std::make_pair((component_id)comp_id, full));
+                    base = &baseline.back().second;
+                }
+            }
+            else if (kind != delta_change_patch || !base || !detail::apply_patch(reader, *base)){
+                return false;
+            }
+
+            utility::io::binary_reader comp_reader(base->empty() ? nullptr : &(*base)[0], base->size());
+            if (!codec->assign(comp_reader, en)){
+                return false;
+            }
+        }
+        return !reader.failed();
+    }
+
+    static int64_t read_id_delta(utility::io::binary_reader& reader){
+        uint64_t delta = 0;
+        reader.read_varint(delta);
+        return (int64_t)delta;
+    }
+};
+}
+
+#endif
\ No newline at end of file
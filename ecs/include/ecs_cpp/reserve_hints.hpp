@@ -0,0 +1,98 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: reserve_hints.hpp
+ *
+ * the capacity hints of the pools(the high-water marks of a run), saved at the shutdown
+ * and loaded at the next startup, so the steady state capacity exists before the first tick
+ *
+ * file format:
+ *  header:  magic(u32) version(u32) entity_count(varint) component_count(varint)
+ *  records: component_id(varint) count(varint)
+ */
+
+#ifndef __ydk_ecs_reserve_hints_hpp__
+#define __ydk_ecs_reserve_hints_hpp__
+
+#include <ecs_cpp/signature.hpp>
+#include <utility/io/binary_stream.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace ecs_cpp
+{
+static const uint32_t reserve_hints_magic   = 0x52534345;   // "ECSR"
+static const uint32_t reserve_hints_version = 1;
+
+struct reserve_hints
+{
+    uint32_t    entity_count;
+
+    /** <component id, the cell count of the component pool> */
+    std::unordered_map<component_id, uint32_t> component_counts;
+
+    reserve_hints() : entity_count(0){}
+
+    bool save(const std::string& path) const{
+        utility::io::binary_writer writer;
+        writer.write_u32(reserve_hints_magic);
+        writer.write_u32(reserve_hints_version);
+        writer.write_varint(entity_count);
+        writer.write_varint(component_counts.size());
+        for (auto& count_kv : component_counts){
+            writer.write_varint(count_kv.first);
+            writer.write_varint(count_kv.second);
+        }
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f){
+            return false;
+        }
+        bool ok = fwrite(writer.data(), 1, writer.size(), f) == writer.size();
+        fclose(f);
+        return ok;
+    }
+
+    /**
+     * @brief load the hints, return false(and the hints are unchanged) if the file is missing or corrupted
+     */
+    bool load(const std::string& path){
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f){
+            return false;
+        }
+
+        std::vector<uint8_t> data;
+        uint8_t buffer[4096];
+        std::size_t n = 0;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0){
+            data.insert(data.end(), buffer, buffer + n);
+        }
+        fclose(f);
+
+        utility::io::binary_reader reader(data.empty() ? nullptr : &data[0], data.size());
+        uint32_t magic = 0, version = 0;
+        uint64_t entitys = 0, count = 0;
+        if (!reader.read_u32(magic) || !reader.read_u32(version) || magic != reserve_hints_magic ||
+            version != reserve_hints_version || !reader.read_varint(entitys) || !reader.read_varint(count)){
+            return false;
+        }
+
+        reserve_hints hints;
+        hints.entity_count = (uint32_t)entitys;
+        for (uint64_t i = 0; i < count; ++i){
+            uint64_t id = 0, comp_count = 0;
+            if (!reader.read_varint(id) || !reader.read_varint(comp_count)){
+                return false;
+            }
+            hints.component_counts[(component_id)id] = (uint32_t)comp_count;
+        }
+        *this = hints;
+        return true;
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,220 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: serialization.hpp
+ *
+ * the component codecs used by the snapshot/replication/journal
+ *
+ * a trivially copyable component is saved as raw bytes(and as a contiguous column in the snapshot),
+ * a tag component(empty struct) is saved as nothing, only the entity list is kept,
+ * the other components need a specialization of component_serializer:
+ *
+ *  template<> struct component_serializer<position>{
+ *      static void save(const position& comp, utility::io::binary_writer& writer);
+ *      static position load(utility::io::binary_reader& reader);
+ *  };
+ */
+
+#ifndef __ydk_ecs_serialization_hpp__
+#define __ydk_ecs_serialization_hpp__
+
+#include <ecs_cpp/entity.hpp>
+#include <utility/io/binary_stream.hpp>
+#include <type_traits>
+#include <unordered_map>
+#include <cstring>
+
+namespace ecs_cpp
+{
+/** specialize it for the components that are not trivially copyable */
+template<typename C>
+struct component_serializer;
+
+struct component_codec
+{
+    component_id    id;
+    uint32_t        size;       // sizeof the component, 0 for a tag
+    bool            column;     // trivially copyable, saved as raw bytes
+
+    /** serialize one component */
+    void (*save)(const void* comp, utility::io::binary_writer& writer);
+
+    /** construct the component on the entity, no event fired(bulk load) */
+    bool (*load)(utility::io::binary_reader& reader, entity* en);
+
+    /** add or replace the component on the entity, the events are fired */
+    bool (*assign)(utility::io::binary_reader& reader, entity* en);
+
+    /** construct count components from a contiguous column, no event fired, only for the column codec */
+    void (*load_column)(entity* const* ens, const uint8_t* data, uint64_t count);
+};
+
+namespace detail
+{
+    template<typename C>
+    struct column_codec
+    {
+        typedef typename std::aligned_storage<sizeof(C), alignof(C)>::type storage_t;
+
+        /** the bytes in a journal record or a delta are not aligned for C, copy them to an aligned storage first */
+        static const C& copy_out(storage_t& storage, const uint8_t* data){
+            std::memcpy(&storage, data, sizeof(C));
+            return *reinterpret_cast<const C*>(&storage);
+        }
+
+        static void save(const void* comp, utility::io::binary_writer& writer){
+            writer.write_bytes(comp, sizeof(C));
+        }
+
+        static bool read(utility::io::binary_reader& reader, C& value){
+            return reader.read_bytes(&value, sizeof(C));
+        }
+
+        static bool load(utility::io::binary_reader& reader, entity* en){
+            const uint8_t* data = reader.read_view(sizeof(C));
+            if (!data){
+                return false;
+            }
+            storage_t storage;
+            en->template add_component_no_check<C>(copy_out(storage, data));
+            return true;
+        }
+
+        static bool assign(utility::io::binary_reader& reader, entity* en){
+            const uint8_t* data = reader.read_view(sizeof(C));
+            if (!data){
+                return false;
+            }
+            storage_t storage;
+            en->template replace_component<C>(copy_out(storage, data));
+            return true;
+        }
+
+        static void load_column(entity* const* ens, const uint8_t* data, uint64_t count){
+            storage_t storage;
+            for (uint64_t i = 0; i < count; ++i){
+                ens[i]->template add_component_no_check<C>(copy_out(storage, data + i * sizeof(C)));
+            }
+        }
+    };
+
+    template<typename C>
+    struct custom_codec
+    {
+        static void save(const void* comp, utility::io::binary_writer& writer){
+            component_serializer<C>::save(*static_cast<const C*>(comp), writer);
+        }
+
+        static bool load(utility::io::binary_reader& reader, entity* en){
+            C value = component_serializer<C>::load(reader);
+            if (reader.failed()){
+                return false;
+            }
+            en->template add_component_no_check<C>(std::move(value));
+            return true;
+        }
+
+        static bool assign(utility::io::binary_reader& reader, entity* en){
+            C value = component_serializer<C>::load(reader);
+            if (reader.failed()){
+                return false;
+            }
+            en->template replace_component<C>(std::move(value));
+            return true;
+        }
+    };
+
+    /** the tags have no data */
+    template<typename C>
+    struct tag_codec
+    {
+        static void save(const void* /*comp*/, utility::io::binary_writer& /*writer*/){
+        }
+
+        static bool load(utility::io::binary_reader& /*reader*/, entity* en){
+            en->template add_component_no_check<C>();
+            return true;
+        }
+
+        static bool assign(utility::io::binary_reader& /*reader*/, entity* en){
+            en->template replace_component<C>();
+            return true;
+        }
+
+        static void load_column(entity* const* ens, const uint8_t* /*data*/, uint64_t count){
+            for (uint64_t i = 0; i < count; ++i){
+                ens[i]->template add_component_no_check<C>();
+            }
+        }
+    };
+
+    template<typename C>
+    void fill_codec(component_codec& codec, std::true_type /* trivially copyable */){
+        codec.column = true;
+        codec.save = &column_codec<C>::save;
+        codec.load = &column_codec<C>::load;
+        codec.assign = &column_codec<C>::assign;
+        codec.load_column = &column_codec<C>::load_column;
+    }
+
+    template<typename C>
+    void fill_codec(component_codec& codec, std::false_type /* custom serializer */){
+        codec.column = false;
+        codec.save = &custom_codec<C>::save;
+        codec.load = &custom_codec<C>::load;
+        codec.assign = &custom_codec<C>::assign;
+        codec.load_column = nullptr;
+    }
+
+    template<typename C>
+    void fill_tag_codec(component_codec& codec, std::true_type /* tag */){
+        codec.size = 0;
+        codec.column = true;
+        codec.save = &tag_codec<C>::save;
+        codec.load = &tag_codec<C>::load;
+        codec.assign = &tag_codec<C>::assign;
+        codec.load_column = &tag_codec<C>::load_column;
+    }
+
+    template<typename C>
+    void fill_tag_codec(component_codec& codec, std::false_type /* not tag */){
+        fill_codec<C>(codec, std::integral_constant<bool, std::is_trivially_copyable<C>::value>());
+    }
+}
+
+class component_codec_registry
+{
+protected:
+    std::unordered_map<component_id, component_codec> codecs_;
+
+public:
+    template<typename C>
+    component_codec_registry& register_component(){
+        component_codec codec;
+        codec.id = typeid(C).hash_code();
+        codec.size = sizeof(C);
+        detail::fill_tag_codec<C>(codec, is_tag_component<C>());
+        codecs_[codec.id] = codec;
+        return *this;
+    }
+
+    const component_codec* find(component_id id) const{
+        auto iter = codecs_.find(id);
+        if (iter != codecs_.end()){
+            return &iter->second;
+        }
+        return nullptr;
+    }
+
+    template<typename C>
+    const component_codec* find() const{
+        return find(typeid(C).hash_code());
+    }
+
+    uint32_t size() const{
+        return codecs_.size();
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: shared_component.hpp
+ *
+ * the shared(flyweight) components, the entitys with the same value reference one
+ * interned ref-counted value, and the entitys are grouped by the value for batch processing
+ *
+ * the trivially copyable components are interned by their bytes, the others need a
+ * specialization of shared_component_traits:
+ *
+ *  template<> struct shared_component_traits<mesh_desc>{
+ *      static std::size_t hash(const mesh_desc& value);
+ *      static bool equal(const mesh_desc& a, const mesh_desc& b);
+ *  };
+ */
+
+#ifndef __ydk_ecs_shared_component_hpp__
+#define __ydk_ecs_shared_component_hpp__
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ecs_cpp
+{
+class entity;
+
+template<typename C>
+struct shared_component_traits
+{
+    static_assert(std::is_trivially_copyable<C>::value,
+        "specialize shared_component_traits for the shared component that is not trivially copyable");
+
+    /** fnv1a of the bytes, the values that differ only in the padding are interned separately */
+    static std::size_t hash(const C& value){
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+        uint32_t h = 2166136261u;
+        for (std::size_t i = 0; i < sizeof(C); ++i){
+            h = (h ^ p[i]) * 16777619u;
+        }
+        return h;
+    }
+
+    static bool equal(const C& a, const C& b){
+        return memcmp(&a, &b, sizeof(C)) == 0;
+    }
+};
+
+class shared_component_store_base
+{
+public:
+    virtual ~shared_component_store_base(){}
+
+    /**
+     * @brief the entity drops its reference to the value, the value is freed with the last reference
+     */
+    virtual void release(void* value, entity* en) = 0;
+
+    /**
+     * @brief the count of the distinct values
+     */
+    virtual std::size_t value_count() const = 0;
+
+    /**
+     * @brief free all the values, the entitys no longer reference them(entity_manager::clear)
+     */
+    virtual void clear() = 0;
+};
+
+template<typename C>
+class shared_component_store : public shared_component_store_base
+{
+public:
+    typedef std::unordered_set<entity*> entity_set;
+
+protected:
+    struct entry_t{
+        C           value;
+        entity_set  entitys;    // the referencing entitys, the size is the ref count
+
+        entry_t(const C& v) : value(v){}
+    };
+
+    /** <value hash, entry> */
+    std::unordered_multimap<std::size_t, entry_t*> entrys_;
+
+public:
+    virtual ~shared_component_store(){
+        clear();
+    }
+
+public:
+    /**
+     * @brief get the interned value equal to value(create if not exists), and reference it by the entity
+     */
+    C* acquire(const C& value, entity* en){
+        std::size_t hash = shared_component_traits<C>::hash(value);
+        auto range = entrys_.equal_range(hash);
+        for (auto iter = range.first; iter != range.second; ++iter){
+            if (shared_component_traits<C>::equal(iter->second->value, value)){
+                iter->second->entitys.insert(en);
+                return &iter->second->value;
+            }
+        }
+
+        entry_t* entry = new entry_t(value);
+        entry->entitys.insert(en);
+        entrys_.insert(std::make_pair(hash, entry));
+        return &entry->value;
+    }
+
+    virtual void release(void* value, entity* en) override{
+        C* v = static_cast<C*>(value);
+        auto range = entrys_.equal_range(shared_component_traits<C>::hash(*v));
+        for (auto iter = range.first; iter != range.second; ++iter){
+            entry_t* entry = iter->second;
+            if (&entry->value == v){
+                entry->entitys.erase(en);
+                if (entry->entitys.empty()){
+                    entrys_.erase(iter);
+                    delete entry;
+                }
+                return;
+            }
+        }
+    }
+
+    virtual std::size_t value_count() const override{
+        return entrys_.size();
+    }
+
+    virtual void clear() override{
+        for (auto& entry_kv : entrys_){
+            delete entry_kv.second;
+        }
+        entrys_.clear();
+    }
+
+    /**
+     * @brief visit the values and their entitys, f(const C& value, const entity_set& entitys)
+     * the visitor must not add/remove the shared components
+     */
+    template<typename F>
+    void for_each(F f){
+        for (auto& entry_kv : entrys_){
+            f(static_cast<const C&>(entry_kv.second->value), static_cast<const entity_set&>(entry_kv.second->entitys));
+        }
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: signature.hpp
+ *
+ * the component signature of an entity, one bit per component type
+ *
+ * the bits are assigned process wide at the first use of a component type, the first
+ * ECS_CPP_MAX_COMPONENT_TYPES types get a bit, the others are only found through the component map.
+ * the tag components(empty structs) are stored only as the bit, so they always need one.
+ */
+
+#ifndef __ydk_ecs_signature_hpp__
+#define __ydk_ecs_signature_hpp__
+
+#include <cstdint>
+#include <bitset>
+#include <mutex>
+#include <vector>
+#include <typeinfo>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#ifndef ECS_CPP_MAX_COMPONENT_TYPES
+#define ECS_CPP_MAX_COMPONENT_TYPES 128
+#endif
+
+namespace ecs_cpp
+{
+typedef uint32_t component_id;
+typedef std::bitset<ECS_CPP_MAX_COMPONENT_TYPES> component_signature;
+
+static const uint32_t invalid_component_bit = 0xffffffff;
+
+/** the empty structs are the tag components, they have no storage */
+template<typename C>
+struct is_tag_component : std::integral_constant<bool, std::is_empty<C>::value>{};
+
+class component_type_registry
+{
+public:
+    struct type_info_t{
+        uint32_t    bit;
+        bool        tag;
+    };
+
+    /** the signature mask of a component type pack */
+    struct mask_t{
+        component_signature mask;
+        bool                complete;   // false if any type of the pack has no bit
+    };
+
+protected:
+    std::mutex                                      mutex_;
+    std::unordered_map<component_id, type_info_t>   types_;
+    std::vector<component_id>                       bit_types_;     // <bit, component id>
+    component_signature                             tag_mask_;
+
+public:
+    static component_type_registry& instance(){
+        static component_type_registry registry;
+        return registry;
+    }
+
+    /**
+     * @brief the signature bit of the component type, invalid_component_bit if the bits are used up
+     */
+    template<typename C>
+    static uint32_t bit(){
+        static const uint32_t b = instance().register_type((component_id)typeid(C).hash_code(), is_tag_component<C>::value);
+        return b;
+    }
+
+    /**
+     * @brief the mask of the component type pack, built once per pack
+     */
+    template<typename... Components>
+    static const mask_t& mask(){
+        static const mask_t m = make_mask<Components...>();
+        return m;
+    }
+
+public:
+    /**
+     * @brief get or assign the bit of the component type
+     * throw if it's a tag and the bits are used up
+     */
+    uint32_t register_type(component_id id, bool tag){
+        std::lock_guard<std::mutex> locker(mutex_);
+        auto iter = types_.find(id);
+        if (iter != types_.end()){
+            return iter->second.bit;
+        }
+
+        type_info_t info;
+        info.tag = tag;
+        info.bit = invalid_component_bit;
+        if (bit_types_.size() < ECS_CPP_MAX_COMPONENT_TYPES){
+            info.bit = (uint32_t)bit_types_.size();
+            bit_types_.push_back(id);
+            if (tag){
+                tag_mask_.set(info.bit);
+            }
+        }
+        else if (tag){
+            throw std::runtime_error("register tag component failed, exceeds ECS_CPP_MAX_COMPONENT_TYPES");
+        }
+
+        types_[id] = info;
+        return info.bit;
+    }
+
+    /**
+     * @brief the bit and tag flag of the component type, false if the type is not registered
+     * the info of a type never changes once registered, so each thread keeps a copy of what it has
+     * looked up, and only a thread's first lookup of a type takes the lock
+     */
+    bool find(component_id id, type_info_t& info){
+        static thread_local std::unordered_map<component_id, type_info_t> cache;
+        auto cache_iter = cache.find(id);
+        if (cache_iter != cache.end()){
+            info = cache_iter->second;
+            return true;
+        }
+
+        std::lock_guard<std::mutex> locker(mutex_);
+        auto iter = types_.find(id);
+        if (iter == types_.end()){
+            return false;
+        }
+        info = iter->second;
+        cache.insert(std::make_pair(id, info));
+        return true;
+    }
+
+    /**
+     * @brief the component type of the bit, 0 if the bit is not assigned
+     * a bit never changes once assigned, so each thread keeps a copy as find does
+     */
+    component_id id_of_bit(uint32_t bit){
+        static thread_local component_id cache[ECS_CPP_MAX_COMPONENT_TYPES] = {};
+        if (bit >= ECS_CPP_MAX_COMPONENT_TYPES){
+            return 0;
+        }
+
+        if (cache[bit] == 0){
+            std::lock_guard<std::mutex> locker(mutex_);
+            if (bit < bit_types_.size()){
+                cache[bit] = bit_types_[bit];
+            }
+        }
+        return cache[bit];
+    }
+
+    component_signature tag_mask(){
+        std::lock_guard<std::mutex> locker(mutex_);
+        return tag_mask_;
+    }
+
+protected:
+    template<typename... Components>
+    static mask_t make_mask(){
+        mask_t m;
+        m.complete = true;
+        int dummy[] = { 0, (add_to_mask(m, bit<Components>()), 0)... };
+        (void)dummy;
+        return m;
+    }
+
+    static void add_to_mask(mask_t& m, uint32_t b){
+        if (b != invalid_component_bit){
+            m.mask.set(b);
+        }
+        else{
+            m.complete = false;
+        }
+    }
+};
+}
+
+#endif
\ No newline at end of file
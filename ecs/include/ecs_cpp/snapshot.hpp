@@ -0,0 +1,354 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: snapshot.hpp
+ *
+ * save/load the whole context(entitys, component data, ids) to a versioned binary file
+ *
+ * file format(little endian, the columns are 16 bytes aligned so the mapped file can be bulk copied):
+ *  header:     magic(u32) version(u32) next_entity_id(u64) entity_count(u64) section_count(u32) reserved(u32)
+ *  entitys:    entity_id(u64) * entity_count
+ *  flags:      entity_flags(u8) * entity_count(snapshot_entity_disabled), padding, since version 2
+ *  sections:   one section per component type
+ *      component_id(u32) flags(u32) element_size(u32) reserved(u32) count(u64)
+ *      entity_index(u32) * count, padding
+ *      column:     element_size * count, padding
+ *      serialized: payload_size(u64), (length(varint) bytes) * count, padding
+ */
+
+#ifndef __ydk_ecs_snapshot_hpp__
+#define __ydk_ecs_snapshot_hpp__
+
+#include <ecs_cpp/context.hpp>
+#include <ecs_cpp/serialization.hpp>
+#include <utility/io/binary_stream.hpp>
+#include <utility/io/mapped_file.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+namespace ecs_cpp
+{
+static const uint32_t snapshot_magic        = 0x53534345;   // "ECSS"
+static const uint32_t snapshot_version      = 2;
+static const uint32_t snapshot_flag_column  = 1;
+static const uint8_t  snapshot_entity_disabled = 1;
+static const uint32_t snapshot_alignment    = 16;
+
+struct snapshot_stats
+{
+    uint64_t    entity_count;
+    uint32_t    column_section_count;
+    uint32_t    serialized_section_count;
+    uint64_t    skipped_component_count;    // the components without a registered codec
+    uint64_t    byte_count;
+
+    snapshot_stats()
+        : entity_count(0), column_section_count(0), serialized_section_count(0)
+        , skipped_component_count(0), byte_count(0){}
+};
+
+class snapshot
+{
+protected:
+    const component_codec_registry& registry_;
+    snapshot_stats                  stats_;
+
+public:
+    snapshot(const component_codec_registry& registry)
+        : registry_(registry){
+    }
+
+public:
+    /**
+     * @brief save the context to the file
+     * the components without a registered codec are skipped
+     */
+    bool save(context& ctx, const std::string& path){
+        utility::io::binary_writer writer;
+        save(ctx, writer);
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f){
+            return false;
+        }
+        bool ok = fwrite(writer.data(), 1, writer.size(), f) == writer.size();
+        ok = (fclose(f) == 0) && ok;
+        return ok;
+    }
+
+    void save(context& ctx, utility::io::binary_writer& writer){
+        stats_ = snapshot_stats();
+        entity_manager& mgr = ctx.entity_admin;
+
+        // entitys are sorted by id, the snapshot is deterministic
+        std::vector<entity*> ens;
+        ens.reserve(mgr.entity_map_.size());
+        for (auto& en_kv : mgr.entity_map_){
+            ens.push_back(en_kv.second);
+        }
+        std::sort(ens.begin(), ens.end(), [](entity* a, entity* b){ return a->entity_id_ < b->entity_id_; });
+
+        // collect the sections
+        struct section_t{
+            const component_codec*          codec;
+            std::vector<uint32_t>           indexs;
+            std::vector<const void*>   comps;
+        };
+        std::map<component_id, section_t> sections;
+        for (uint32_t i = 0; i < ens.size(); ++i){
+            ens[i]->for_each_component([&](component_id id, void* comp){
+                const component_codec* codec = registry_.find(id);
+                if (!codec){
+                    ++stats_.skipped_component_count;
+                    return;
+                }
+                section_t& sec = sections[id];
+                sec.codec = codec;
+                sec.indexs.push_back(i);
+                sec.comps.push_back(comp);
+            });
+        }
+
+        std::size_t begin = writer.size();
+        writer.write_u32(snapshot_magic);
+        writer.write_u32(snapshot_version);
+        writer.write_u64((uint64_t)mgr.next_entity_id_);
+        writer.write_u64(ens.size());
+        writer.write_u32((uint32_t)sections.size());
+        writer.write_u32(0);
+
+        for (entity* en : ens){
+            writer.write_u64((uint64_t)en->entity_id_);
+        }
+        for (entity* en : ens){
+            writer.write_u8(en->enabled() ? 0 : snapshot_entity_disabled);
+        }
+        align(writer, begin);
+
+        for (auto& sec_kv : sections){
+            section_t& sec = sec_kv.second;
+            const component_codec* codec = sec.codec;
+            uint64_t count = sec.indexs.size();
+
+            writer.write_u32(codec->id);
+            writer.write_u32(codec->column ? snapshot_flag_column : 0);
+            writer.write_u32(codec->size);
+            writer.write_u32(0);
+            writer.write_u64(count);
+            for (uint32_t index : sec.indexs){
+                writer.write_u32(index);
+            }
+            align(writer, begin);
+
+            if (codec->column){
+                for (const void* comp : sec.comps){
+                    codec->save(comp, writer);
+                }
+                ++stats_.column_section_count;
+            }
+            else{
+                std::size_t size_pos = writer.size();
+                writer.write_u64(0);
+                utility::io::binary_writer elem_writer;
+                for (const void* comp : sec.comps){
+                    elem_writer.clear();
+                    codec->save(comp, elem_writer);
+                    writer.write_varint(elem_writer.size());
+                    writer.write_bytes(elem_writer.data(), elem_writer.size());
+                }
+                uint64_t payload_size = writer.size() - size_pos - 8;
+                writer.patch_u32(size_pos, (uint32_t)payload_size);
+                writer.patch_u32(size_pos + 4, (uint32_t)(payload_size >> 32));
+                ++stats_.serialized_section_count;
+            }
+            align(writer, begin);
+        }
+
+        stats_.entity_count = ens.size();
+        stats_.byte_count = writer.size() - begin;
+    }
+
+    /**
+     * @brief load the file into the context, the file is memory mapped
+     * the context must have no entity, the groups are rebuilt in one pass after the load,
+     * no entity/component event is fired for the loaded data, the disabled entitys are disabled
+     * by entity::set_enabled after the groups are rebuilt
+     * the sections of the unregistered component types are skipped
+     * @return false if the file is invalid, the context may be partially loaded
+     */
+    bool load(context& ctx, const std::string& path){
+        utility::io::mapped_file file;
+        if (!file.open(path)){
+            return false;
+        }
+        return load(ctx, file.data(), file.size());
+    }
+
+    bool load(context& ctx, const uint8_t* data, std::size_t size){
+        stats_ = snapshot_stats();
+        entity_manager& mgr = ctx.entity_admin;
+        if (!mgr.entity_map_.empty()){
+            return false;
+        }
+
+        utility::io::binary_reader reader(data, size);
+        uint32_t magic = 0, version = 0, section_count = 0, reserved = 0;
+        uint64_t next_entity_id = 0, entity_count = 0;
+        reader.read_u32(magic);
+        reader.read_u32(version);
+        reader.read_u64(next_entity_id);
+        reader.read_u64(entity_count);
+        reader.read_u32(section_count);
+        reader.read_u32(reserved);
+        if (reader.failed() || magic != snapshot_magic || version == 0 || version > snapshot_version ||
+            entity_count > reader.remain() / 8){
+            return false;
+        }
+
+        std::vector<entity*> ens((std::size_t)entity_count);
+        for (uint64_t i = 0; i < entity_count; ++i){
+            uint64_t id = 0;
+            reader.read_u64(id);
+            ens[(std::size_t)i] = mgr.create_entity_no_event((int64_t)id);
+            if (!ens[(std::size_t)i]){
+                // a duplicate id
+                return false;
+            }
+        }
+        if ((int64_t)next_entity_id > mgr.next_entity_id_){
+            mgr.next_entity_id_ = (int64_t)next_entity_id;
+        }
+
+        // version 1 has no flags, all the entitys are enabled
+        const uint8_t* entity_flags = nullptr;
+        if (version >= 2){
+            entity_flags = reader.read_view((std::size_t)entity_count);
+            if (!entity_flags && entity_count > 0){
+                return false;
+            }
+            skip_align(reader);
+        }
+
+        std::vector<entity*> section_ens;
+        for (uint32_t s = 0; s < section_count; ++s){
+            uint32_t id = 0, flags = 0, elem_size = 0;
+            uint64_t count = 0;
+            reader.read_u32(id);
+            reader.read_u32(flags);
+            reader.read_u32(elem_size);
+            reader.read_u32(reserved);
+            reader.read_u64(count);
+            if (reader.failed() || count > reader.remain() / 4){
+                return false;
+            }
+
+            section_ens.resize((std::size_t)count);
+            for (uint64_t i = 0; i < count; ++i){
+                uint32_t index = 0;
+                reader.read_u32(index);
+                if (index >= ens.size()){
+                    return false;
+                }
+                section_ens[(std::size_t)i] = ens[index];
+            }
+            skip_align(reader);
+
+            const component_codec* codec = registry_.find(id);
+            bool column = (flags & snapshot_flag_column) != 0;
+            if (column){
+                if (elem_size > 0 && count > reader.remain() / elem_size){
+                    return false;
+                }
+                uint64_t column_size = count * elem_size;
+                const uint8_t* column_data = reader.read_view((std::size_t)column_size);
+                if (!column_data){
+                    return false;
+                }
+
+                if (!codec){
+                    stats_.skipped_component_count += count;
+                }
+                else if (!codec->column || codec->size != elem_size){
+                    // the component layout has changed
+                    return false;
+                }
+                else{
+                    codec->load_column(section_ens.empty() ? nullptr : &section_ens[0], column_data, count);
+                    ++stats_.column_section_count;
+                }
+            }
+            else{
+                uint64_t payload_size = 0;
+                reader.read_u64(payload_size);
+                if (!reader.fits(payload_size)){
+                    return false;
+                }
+                const uint8_t* payload = reader.read_view((std::size_t)payload_size);
+                if (!payload){
+                    return false;
+                }
+
+                if (!codec){
+                    stats_.skipped_component_count += count;
+                }
+                else if (codec->column){
+                    return false;
+                }
+                else{
+                    utility::io::binary_reader payload_reader(payload, (std::size_t)payload_size);
+                    for (entity* en : section_ens){
+                        uint64_t elem_size = 0;
+                        payload_reader.read_varint(elem_size);
+                        if (!payload_reader.fits(elem_size)){
+                            return false;
+                        }
+                        const uint8_t* elem = payload_reader.read_view((std::size_t)elem_size);
+                        if (!elem){
+                            return false;
+                        }
+                        utility::io::binary_reader elem_reader(elem, (std::size_t)elem_size);
+                        if (!codec->load(elem_reader, en)){
+                            return false;
+                        }
+                    }
+                    ++stats_.serialized_section_count;
+                }
+            }
+            skip_align(reader);
+        }
+
+        mgr.rebuild_groups();
+        for (uint64_t i = 0; entity_flags && i < entity_count; ++i){
+            if ((entity_flags[i] & snapshot_entity_disabled) != 0){
+                ens[(std::size_t)i]->set_enabled(false);
+            }
+        }
+
+        stats_.entity_count = entity_count;
+        stats_.byte_count = size;
+        return true;
+    }
+
+    /** the stats of the last save/load */
+    const snapshot_stats& stats() const{
+        return stats_;
+    }
+
+protected:
+    static void align(utility::io::binary_writer& writer, std::size_t begin){
+        static const uint8_t zeros[snapshot_alignment] = { 0 };
+        std::size_t pad = (snapshot_alignment - (writer.size() - begin) % snapshot_alignment) % snapshot_alignment;
+        writer.write_bytes(zeros, pad);
+    }
+
+    static void skip_align(utility::io::binary_reader& reader){
+        std::size_t pad = (snapshot_alignment - reader.position() % snapshot_alignment) % snapshot_alignment;
+        reader.skip((std::min)(pad, reader.remain()));
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,282 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: sorted_group.hpp
+ *
+ * a group that keeps its entitys ordered by a key of a component(render depth, ai priority...)
+ *
+ *  sorted_group<position, float> by_depth(ctx.entity_admin, matcher::all_of<position, sprite>(),
+ *      [](const position& pos){ return pos.z; });
+ *  by_depth.for_each([](entity* en){ ... });
+ *
+ * the order is kept incrementally: a new member is inserted by binary search, and a member whose
+ * keyed component is replaced is moved to its new place, no full sort is needed.
+ * the members are kept in a contiguous vector of <key, entity> for the ordered iteration.
+ * the keyed component written in place must be marked changed(entity::mark_changed) or reindexed by reindex(en)
+ */
+
+#ifndef __ydk_ecs_sorted_group_hpp__
+#define __ydk_ecs_sorted_group_hpp__
+
+#include <ecs_cpp/entity_manager.hpp>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace ecs_cpp
+{
+template<typename C, typename Key, typename Compare = std::less<Key>>
+class sorted_group
+{
+public:
+    typedef std::function<Key(const C&)> key_getter;
+
+    struct item_t{
+        Key         key;
+        entity*     en;
+    };
+
+protected:
+    entity_manager&         entity_mgr_;
+    matcher::ptr            mather_;
+    key_getter              key_getter_;
+    Compare                 compare_;
+    component_id            component_id_;
+
+    /** the members ordered by the key, the equal keys are in the insert order */
+    std::vector<item_t>     items_;
+
+    /** <member, key> */
+    std::unordered_map<entity*, Key> keys_;
+
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+public:
+    /**
+     * @param mther - the membership, the entitys must also have the keyed component C
+     */
+    sorted_group(entity_manager& entity_mgr, matcher::ptr mther, key_getter getter, Compare compare = Compare())
+        : entity_mgr_(entity_mgr)
+        , mather_(mther)
+        , key_getter_(getter)
+        , compare_(compare)
+        , component_id_((component_id)typeid(C).hash_code())
+    {
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&sorted_group::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&sorted_group::event_cleared, this));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&sorted_group::event_component_added, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&sorted_group::event_component_replaced, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&sorted_group::event_component_removed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&sorted_group::event_component_changed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+        subscribe_events(1);
+        rebuild();
+    }
+
+    ~sorted_group(){
+        subscribe_events(0);
+    }
+
+    sorted_group(const sorted_group&) = delete;
+    sorted_group& operator = (const sorted_group&) = delete;
+
+public:
+    uint32_t entity_count() const{
+        return items_.size();
+    }
+
+    /**
+     * @brief the raw ordered storage: all the members in the key order, the disabled members included,
+     * use for_each for the enabled members only
+     */
+    const std::vector<item_t>& items() const{
+        return items_;
+    }
+
+    /**
+     * @brief visit the enabled members in the key order, f(entity*)
+     * the visitor must not change the membership or the keys
+     */
+    template<typename F>
+    void for_each(F f){
+        for (auto& item : items_){
+            if (item.en->enabled()){
+                f(item.en);
+            }
+        }
+    }
+
+    /**
+     * @brief move the entity to its place after the keyed component is written in place without entity::mark_changed
+     */
+    void reindex(entity* en){
+        handle_entity(en);
+    }
+
+    /**
+     * @brief match all the entitys and sort again
+     */
+    void rebuild(){
+        items_.clear();
+        keys_.clear();
+        entity_mgr_.for_each_entity([this](entity* en){
+            if (matches(en)){
+                item_t item = { key_getter_(*en->get_component<C>()), en };
+                items_.push_back(item);
+                keys_.insert(std::make_pair(en, item.key));
+            }
+        });
+
+        Compare& compare = compare_;
+        std::stable_sort(items_.begin(), items_.end(), [&compare](const item_t& a, const item_t& b){
+            return compare(a.key, b.key);
+        });
+    }
+
+protected:
+    bool matches(entity* en){
+        return en->has_component(component_id_) && mather_->matches(en);
+    }
+
+    /** rematch the entity, and move it if the key has changed */
+    void handle_entity(entity* en){
+        if (!matches(en)){
+            erase(en);
+            return;
+        }
+
+        Key key = key_getter_(*en->get_component<C>());
+        auto iter = keys_.find(en);
+        if (iter == keys_.end()){
+            keys_.insert(std::make_pair(en, key));
+            item_t item = { key, en };
+            items_.insert(upper_bound(key), item);
+            return;
+        }
+
+        if (!compare_(iter->second, key) && !compare_(key, iter->second)){
+            return;
+        }
+
+        // rotate the item to the new place, only the items between move
+        std::size_t from = position(en, iter->second);
+        iter->second = key;
+        if (from == items_.size()){
+            item_t item = { key, en };
+            items_.insert(upper_bound(key), item);
+            return;
+        }
+        items_[from].key = key;
+        if (from > 0 && compare_(key, items_[from - 1].key)){
+            std::size_t to = upper_bound(key, 0, from) - items_.begin();
+            std::rotate(items_.begin() + to, items_.begin() + from, items_.begin() + from + 1);
+        }
+        else{
+            std::size_t to = upper_bound(key, from + 1, items_.size()) - items_.begin();
+            std::rotate(items_.begin() + from, items_.begin() + from + 1, items_.begin() + to);
+        }
+    }
+
+    void erase(entity* en){
+        auto iter = keys_.find(en);
+        if (iter != keys_.end()){
+            std::size_t pos = position(en, iter->second);
+            if (pos < items_.size()){
+                items_.erase(items_.begin() + pos);
+            }
+            keys_.erase(iter);
+        }
+    }
+
+    typename std::vector<item_t>::iterator upper_bound(const Key& key){
+        return upper_bound(key, 0, items_.size());
+    }
+
+    typename std::vector<item_t>::iterator upper_bound(const Key& key, std::size_t first, std::size_t last){
+        Compare& compare = compare_;
+        return std::upper_bound(items_.begin() + first, items_.begin() + last, key, [&compare](const Key& k, const item_t& item){
+            return compare(k, item.key);
+        });
+    }
+
+    /**
+     * the position of the member, binary search of the key then scan the equal keys,
+     * items_.size() if it's not found
+     */
+    std::size_t position(entity* en, const Key& key){
+        Compare& compare = compare_;
+        auto iter = std::lower_bound(items_.begin(), items_.end(), key, [&compare](const item_t& item, const Key& k){
+            return compare(item.key, k);
+        });
+        for (; iter != items_.end() && !compare(key, iter->key); ++iter){
+            if (iter->en == en){
+                return iter - items_.begin();
+            }
+        }
+
+        // a key that breaks the order of Compare(a NaN), scan all
+        for (std::size_t i = 0; i < items_.size(); ++i){
+            if (items_[i].en == en){
+                return i;
+            }
+        }
+        return items_.size();
+    }
+
+    void subscribe_events(int32_t mode){
+        entity_mgr_.subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+        entity_mgr_.subscribe_clear_event(&cleared_subscriber_, mode);
+        entity_mgr_.subscribe_component_added_event(&component_added_subscriber_, mode);
+        entity_mgr_.subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+        entity_mgr_.subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        entity_mgr_.subscribe_component_change_event(&component_changed_subscriber_, mode);
+    }
+
+    void event_entity_removed(entity* en){
+        erase(en);
+    }
+
+    void event_cleared(){
+        items_.clear();
+        keys_.clear();
+    }
+
+    void event_component_added(entity* en, component_id id, void* /*comp*/){
+        if (id == component_id_ || mather_->involves(id)){
+            handle_entity(en);
+        }
+    }
+
+    void event_component_replaced(entity* en, component_id id, void* /*old_comp*/, void* /*new_comp*/){
+        if (id == component_id_){
+            handle_entity(en);
+        }
+    }
+
+    void event_component_removed(entity* en, component_id id, void* /*comp*/){
+        if (id == component_id_ || mather_->involves(id)){
+            handle_entity(en);
+        }
+    }
+
+    void event_component_changed(entity* en, component_id id, void* /*comp*/){
+        if (id == component_id_){
+            handle_entity(en);
+        }
+    }
+};
+}
+
+#endif
\ No newline at end of file
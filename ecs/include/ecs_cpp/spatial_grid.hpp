@@ -0,0 +1,395 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: spatial_grid.hpp
+ *
+ * a spatial index over a position-like component, a sparse uniform grid(hashed cells),
+ * kept in sync by the manager level component events
+ *
+ *  spatial_grid<position> grid(ctx.entity_admin, 16.0f,
+ *      [](const position& pos){ return spatial_point(pos.x, pos.y, pos.z); });
+ *  grid.query_radius(spatial_point(0, 0, 0), 50.0f, result);
+ *  grid.query_nearest(spatial_point(0, 0, 0), 8, result);
+ *
+ * the points are copied to the cells, so the queries don't touch the components.
+ * a 2d world just keeps z at 0. the position written in place must be marked changed(entity::mark_changed) or reindexed by reindex(en)
+ */
+
+#ifndef __ydk_ecs_spatial_grid_hpp__
+#define __ydk_ecs_spatial_grid_hpp__
+
+#include <ecs_cpp/entity_manager.hpp>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+namespace ecs_cpp
+{
+struct spatial_point
+{
+    float   x;
+    float   y;
+    float   z;
+
+    spatial_point() : x(0), y(0), z(0){}
+    spatial_point(float _x, float _y, float _z) : x(_x), y(_y), z(_z){}
+};
+
+template<typename C>
+class spatial_grid
+{
+public:
+    typedef std::function<spatial_point(const C&)> point_getter;
+
+protected:
+    struct cell_key{
+        int32_t x;
+        int32_t y;
+        int32_t z;
+
+        bool operator == (const cell_key& other) const{
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    struct cell_key_hash{
+        std::size_t operator()(const cell_key& key) const{
+            return ((std::size_t)(uint32_t)key.x * 73856093u) ^ ((std::size_t)(uint32_t)key.y * 19349663u) ^ ((std::size_t)(uint32_t)key.z * 83492791u);
+        }
+    };
+
+    struct item_t{
+        spatial_point   point;
+        entity*         en;
+    };
+
+    /** where the entity is */
+    struct location_t{
+        cell_key    cell;
+        uint32_t    index;      // the index in the cell
+    };
+
+    entity_manager&     entity_mgr_;
+    point_getter        point_getter_;
+    component_id        component_id_;
+    float               cell_size_;
+    float               inv_cell_size_;
+
+    std::unordered_map<cell_key, std::vector<item_t>, cell_key_hash> cells_;
+    std::unordered_map<entity*, location_t> locations_;
+
+    /** the bounds of the cells ever used, the queries don't look beyond */
+    cell_key            min_cell_;
+    cell_key            max_cell_;
+
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_changed_subscriber_;
+
+public:
+    /**
+     * @param cell_size - the edge length of a cell, about the common query radius
+     */
+    spatial_grid(entity_manager& entity_mgr, float cell_size, point_getter getter)
+        : entity_mgr_(entity_mgr)
+        , point_getter_(getter)
+        , component_id_((component_id)typeid(C).hash_code())
+        , cell_size_(cell_size)
+        , inv_cell_size_(1.0f / cell_size)
+    {
+        reset_bounds();
+
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&spatial_grid::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&spatial_grid::event_cleared, this));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&spatial_grid::event_component_added, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&spatial_grid::event_component_replaced, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&spatial_grid::event_component_removed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_changed_subscriber_.register_event_handler(
+            std::bind(&spatial_grid::event_component_changed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+        subscribe_events(1);
+        rebuild();
+    }
+
+    ~spatial_grid(){
+        subscribe_events(0);
+    }
+
+    spatial_grid(const spatial_grid&) = delete;
+    spatial_grid& operator = (const spatial_grid&) = delete;
+
+public:
+    uint32_t entity_count() const{
+        return locations_.size();
+    }
+
+    /**
+     * @brief move the entity after its position is written in place without entity::mark_changed
+     */
+    void reindex(entity* en){
+        C* comp = en->get_component<C>();
+        if (comp){
+            update(en, point_getter_(*comp));
+        }
+        else{
+            erase(en);
+        }
+    }
+
+    void rebuild(){
+        cells_.clear();
+        locations_.clear();
+        reset_bounds();
+        entity_mgr_.for_each_entity([this](entity* en){
+            C* comp = en->get_component<C>();
+            if (comp){
+                update(en, point_getter_(*comp));
+            }
+        });
+    }
+
+    /**
+     * @brief visit the entitys within the radius of the center, f(entity*, const spatial_point&)
+     * the visitor must not move/add/remove the indexed entitys
+     */
+    template<typename F>
+    void for_each_in_radius(const spatial_point& center, float radius, F f){
+        float r2 = radius * radius;
+        spatial_point lo(center.x - radius, center.y - radius, center.z - radius);
+        spatial_point hi(center.x + radius, center.y + radius, center.z + radius);
+        for_each_cell(cell_of(lo), cell_of(hi), [&](const std::vector<item_t>& items){
+            for (const item_t& item : items){
+                if (distance2(item.point, center) <= r2){
+                    f(item.en, item.point);
+                }
+            }
+        });
+    }
+
+    void query_radius(const spatial_point& center, float radius, std::vector<entity*>& result){
+        for_each_in_radius(center, radius, [&result](entity* en, const spatial_point&){
+            result.push_back(en);
+        });
+    }
+
+    /**
+     * @brief visit the entitys in the box [lo, hi], f(entity*, const spatial_point&)
+     */
+    template<typename F>
+    void for_each_in_aabb(const spatial_point& lo, const spatial_point& hi, F f){
+        for_each_cell(cell_of(lo), cell_of(hi), [&](const std::vector<item_t>& items){
+            for (const item_t& item : items){
+                const spatial_point& p = item.point;
+                if (p.x >= lo.x && p.x <= hi.x && p.y >= lo.y && p.y <= hi.y && p.z >= lo.z && p.z <= hi.z){
+                    f(item.en, p);
+                }
+            }
+        });
+    }
+
+    void query_aabb(const spatial_point& lo, const spatial_point& hi, std::vector<entity*>& result){
+        for_each_in_aabb(lo, hi, [&result](entity* en, const spatial_point&){
+            result.push_back(en);
+        });
+    }
+
+    /**
+     * @brief the k nearest entitys of the center, the nearest first
+     * the cells are searched in the growing shells around the center cell, until the next shell
+     * can't be nearer than the k-th found one
+     */
+    void query_nearest(const spatial_point& center, uint32_t k, std::vector<entity*>& result){
+        if (k == 0 || locations_.empty()){
+            return;
+        }
+
+        typedef std::pair<float, entity*> candidate_t;
+        std::priority_queue<candidate_t> best;     // the farthest on the top
+        cell_key c = cell_of(center);
+        int32_t max_shell = (std::max)((std::max)(
+            (std::max)(std::abs(c.x - min_cell_.x), std::abs(max_cell_.x - c.x)),
+            (std::max)(std::abs(c.y - min_cell_.y), std::abs(max_cell_.y - c.y))),
+            (std::max)(std::abs(c.z - min_cell_.z), std::abs(max_cell_.z - c.z)));
+
+        for (int32_t shell = 0; shell <= max_shell; ++shell){
+            cell_key lo = { c.x - shell, c.y - shell, c.z - shell };
+            cell_key hi = { c.x + shell, c.y + shell, c.z + shell };
+            for_each_cell(lo, hi, [&](const std::vector<item_t>& items){
+                for (const item_t& item : items){
+                    float d2 = distance2(item.point, center);
+                    if (best.size() < k){
+                        best.push(candidate_t(d2, item.en));
+                    }
+                    else if (d2 < best.top().first){
+                        best.pop();
+                        best.push(candidate_t(d2, item.en));
+                    }
+                }
+            }, shell);
+
+            // any point of the next shell is at least shell * cell_size away
+            float reach = shell * cell_size_;
+            if (best.size() == k && best.top().first <= reach * reach){
+                break;
+            }
+        }
+
+        std::size_t begin = result.size();
+        while (!best.empty()){
+            result.push_back(best.top().second);
+            best.pop();
+        }
+        std::reverse(result.begin() + begin, result.end());
+    }
+
+protected:
+    cell_key cell_of(const spatial_point& p) const{
+        cell_key key = { (int32_t)std::floor(p.x * inv_cell_size_), (int32_t)std::floor(p.y * inv_cell_size_), (int32_t)std::floor(p.z * inv_cell_size_) };
+        return key;
+    }
+
+    static float distance2(const spatial_point& a, const spatial_point& b){
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    void reset_bounds(){
+        cell_key lo = { INT32_MAX, INT32_MAX, INT32_MAX };
+        cell_key hi = { INT32_MIN, INT32_MIN, INT32_MIN };
+        min_cell_ = lo;
+        max_cell_ = hi;
+    }
+
+    /**
+     * @brief visit the used cells in [lo, hi](clamped to the bounds),
+     * only the cells on the surface of the box if shell >= 0
+     */
+    template<typename F>
+    void for_each_cell(cell_key lo, cell_key hi, F f, int32_t shell = -1){
+        cell_key center = { lo.x + shell, lo.y + shell, lo.z + shell };
+        int32_t x0 = (std::max)(lo.x, min_cell_.x), x1 = (std::min)(hi.x, max_cell_.x);
+        int32_t y0 = (std::max)(lo.y, min_cell_.y), y1 = (std::min)(hi.y, max_cell_.y);
+        int32_t z0 = (std::max)(lo.z, min_cell_.z), z1 = (std::min)(hi.z, max_cell_.z);
+        for (int32_t x = x0; x <= x1; ++x){
+            for (int32_t y = y0; y <= y1; ++y){
+                for (int32_t z = z0; z <= z1; ++z){
+                    if (shell > 0 && std::abs(x - center.x) < shell && std::abs(y - center.y) < shell && std::abs(z - center.z) < shell){
+                        // inside, visited by a smaller shell, jump to the far face
+                        z = center.z + shell - 1;
+                        continue;
+                    }
+
+                    cell_key key = { x, y, z };
+                    auto iter = cells_.find(key);
+                    if (iter != cells_.end()){
+                        f(iter->second);
+                    }
+                }
+            }
+        }
+    }
+
+    void update(entity* en, const spatial_point& point){
+        cell_key key = cell_of(point);
+        auto iter = locations_.find(en);
+        if (iter != locations_.end()){
+            location_t& loc = iter->second;
+            if (loc.cell == key){
+                cells_[key][loc.index].point = point;
+                return;
+            }
+            erase_from_cell(loc);
+            locations_.erase(iter);
+        }
+
+        std::vector<item_t>& items = cells_[key];
+        item_t item = { point, en };
+        location_t loc = { key, (uint32_t)items.size() };
+        items.push_back(item);
+        locations_.insert(std::make_pair(en, loc));
+
+        min_cell_.x = (std::min)(min_cell_.x, key.x); max_cell_.x = (std::max)(max_cell_.x, key.x);
+        min_cell_.y = (std::min)(min_cell_.y, key.y); max_cell_.y = (std::max)(max_cell_.y, key.y);
+        min_cell_.z = (std::min)(min_cell_.z, key.z); max_cell_.z = (std::max)(max_cell_.z, key.z);
+    }
+
+    void erase(entity* en){
+        auto iter = locations_.find(en);
+        if (iter != locations_.end()){
+            erase_from_cell(iter->second);
+            locations_.erase(iter);
+        }
+    }
+
+    /** swap with the last one of the cell */
+    void erase_from_cell(const location_t& loc){
+        auto cell_iter = cells_.find(loc.cell);
+        std::vector<item_t>& items = cell_iter->second;
+        if (loc.index + 1 != items.size()){
+            items[loc.index] = items.back();
+            locations_[items[loc.index].en].index = loc.index;
+        }
+        items.pop_back();
+        if (items.empty()){
+            cells_.erase(cell_iter);
+        }
+    }
+
+    void subscribe_events(int32_t mode){
+        entity_mgr_.subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+        entity_mgr_.subscribe_clear_event(&cleared_subscriber_, mode);
+        entity_mgr_.subscribe_component_added_event(&component_added_subscriber_, mode);
+        entity_mgr_.subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+        entity_mgr_.subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        entity_mgr_.subscribe_component_change_event(&component_changed_subscriber_, mode);
+    }
+
+    void event_entity_removed(entity* en){
+        erase(en);
+    }
+
+    void event_cleared(){
+        cells_.clear();
+        locations_.clear();
+        reset_bounds();
+    }
+
+    void event_component_added(entity* en, component_id id, void* comp){
+        if (id == component_id_){
+            update(en, point_getter_(*static_cast<const C*>(comp)));
+        }
+    }
+
+    void event_component_replaced(entity* en, component_id id, void* /*old_comp*/, void* new_comp){
+        if (id == component_id_){
+            update(en, point_getter_(*static_cast<const C*>(new_comp)));
+        }
+    }
+
+    void event_component_removed(entity* en, component_id id, void* /*comp*/){
+        if (id == component_id_){
+            erase(en);
+        }
+    }
+
+    void event_component_changed(entity* en, component_id id, void* comp){
+        if (id == component_id_){
+            update(en, point_getter_(*static_cast<const C*>(comp)));
+        }
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,478 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: static_world.hpp
+ *
+ * a compile-time typed world for the deployments that know the full component set at build time
+ *
+ *  typedef static_world<position, velocity, stunned> world_type;
+ *  world_type world;
+ *  world.create_entity().add_component<position>(0.f, 0.f).add_component<velocity>(1.f, 1.f);
+ *  world.view<position, velocity>().without<stunned>().each(
+ *      [](static_entity<world_type> en, position& pos, velocity& vel){ ... });
+ *
+ * the components are stored in typed sparse sets(one contiguous array per type), the component
+ * index and the matcher masks are compile-time constants, there is no virtual, typeid or std::function,
+ * so the views are fully inlined. the systems are plain classes run by static_system_manager
+ */
+
+#ifndef __ydk_ecs_static_world_hpp__
+#define __ydk_ecs_static_world_hpp__
+
+#include <ecs_cpp/entity.hpp>
+#include <ecs_cpp/system.hpp>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ecs_cpp
+{
+namespace detail
+{
+    template<typename... Ts>
+    struct type_list{};
+
+    /** the index of T in Ts */
+    template<typename T, typename... Ts>
+    struct index_of;
+
+    template<typename T>
+    struct index_of<T> : std::integral_constant<uint32_t, 0>{
+        static const bool found = false;
+    };
+
+    template<typename T, typename... Ts>
+    struct index_of<T, T, Ts...> : std::integral_constant<uint32_t, 0>{
+        static const bool found = true;
+    };
+
+    template<typename T, typename U, typename... Ts>
+    struct index_of<T, U, Ts...> : std::integral_constant<uint32_t, 1 + index_of<T, Ts...>::value>{
+        static const bool found = index_of<T, Ts...>::found;
+    };
+
+    /** the signature mask of Ts in the component list */
+    template<typename List, typename... Ts>
+    struct mask_of;
+
+    template<typename... Cs>
+    struct mask_of<type_list<Cs...>> : std::integral_constant<uint64_t, 0>{};
+
+    template<typename... Cs, typename T, typename... Ts>
+    struct mask_of<type_list<Cs...>, T, Ts...>
+        : std::integral_constant<uint64_t, (uint64_t(1) << index_of<T, Cs...>::value) | mask_of<type_list<Cs...>, Ts...>::value>{
+        static_assert(index_of<T, Cs...>::found, "the component is not in the static world");
+    };
+}
+
+/**
+ * @brief the typed storage of one component type, a sparse set:
+ * the components are packed in a contiguous array, with the entity index of each one
+ */
+template<typename C>
+class sparse_storage
+{
+public:
+    static const uint32_t npos = 0xffffffff;
+
+protected:
+    std::vector<C>          dense_;
+    std::vector<uint32_t>   dense_index_;       // <dense position, entity index>
+    std::vector<uint32_t>   sparse_;            // <entity index, dense position>
+
+public:
+    /**
+     * @brief add the component of the entity, throw if it already has one(a second dense row would be orphaned)
+     */
+    template<typename... Args>
+    C&  emplace(uint32_t index, Args&& ...args){
+        if (has(index)){
+            throw std::runtime_error("add component to static entity failed, the component already exists");
+        }
+        if (index >= sparse_.size()){
+            sparse_.resize(index + 1, (uint32_t)npos);
+        }
+        sparse_[index] = (uint32_t)dense_.size();
+        dense_.push_back(detail::make_component<C>(
+            std::integral_constant<bool, std::is_constructible<C, Args...>::value>(), std::forward<Args>(args)...));
+        dense_index_.push_back(index);
+        return dense_.back();
+    }
+
+    /** swap with the last one, the order is not kept */
+    void remove(uint32_t index){
+        uint32_t pos = sparse_[index];
+        uint32_t last = (uint32_t)dense_.size() - 1;
+        if (pos != last){
+            dense_[pos] = std::move(dense_[last]);
+            dense_index_[pos] = dense_index_[last];
+            sparse_[dense_index_[pos]] = pos;
+        }
+        dense_.pop_back();
+        dense_index_.pop_back();
+        sparse_[index] = npos;
+    }
+
+    bool has(uint32_t index) const{
+        return index < sparse_.size() && sparse_[index] != npos;
+    }
+
+    C&  get(uint32_t index){
+        return dense_[sparse_[index]];
+    }
+
+    /** the packed components, for the tight loops over one component type */
+    C*  data(){
+        return dense_.empty() ? nullptr : &dense_[0];
+    }
+
+    /** the entity index of each packed component */
+    const uint32_t* indexs() const{
+        return dense_index_.empty() ? nullptr : &dense_index_[0];
+    }
+
+    uint32_t size() const{
+        return (uint32_t)dense_.size();
+    }
+
+    void reserve(uint32_t count){
+        dense_.reserve(count);
+        dense_index_.reserve(count);
+    }
+};
+
+template<typename... Cs>
+class static_world;
+
+/**
+ * @brief the entity handle of a static world, the index is reused after destory,
+ * the generation tells a stale handle: add/replace/remove throw on it, get returns nullptr
+ */
+template<typename World>
+class static_entity
+{
+protected:
+    World*      world_;
+    uint32_t    index_;
+    uint32_t    generation_;
+
+public:
+    static_entity() : world_(nullptr), index_(0), generation_(0){}
+    static_entity(World* world, uint32_t index, uint32_t generation)
+        : world_(world), index_(index), generation_(generation){}
+
+    uint32_t index() const{
+        return index_;
+    }
+
+    uint32_t generation() const{
+        return generation_;
+    }
+
+    bool valid() const{
+        return world_ && world_->valid(*this);
+    }
+
+    void destory(){
+        world_->destory(*this);
+    }
+
+    template<typename C, typename... Args>
+    static_entity& add_component(Args&& ...args){
+        check_valid();
+        world_->template add_component<C>(index_, std::forward<Args>(args)...);
+        return *this;
+    }
+
+    template<typename C, typename... Args>
+    static_entity& replace_component(Args&& ...args){
+        check_valid();
+        world_->template replace_component<C>(index_, std::forward<Args>(args)...);
+        return *this;
+    }
+
+    template<typename C>
+    static_entity& remove_component(){
+        check_valid();
+        world_->template remove_component<C>(index_);
+        return *this;
+    }
+
+    template<typename C>
+    bool has_component() const{
+        return valid() && world_->template has_component<C>(index_);
+    }
+
+    template<typename... Components>
+    bool has_components() const{
+        return valid() && world_->template has_components<Components...>(index_);
+    }
+
+    template<typename C>
+    C*  get_component(){
+        return valid() ? world_->template get_component<C>(index_) : nullptr;
+    }
+
+    bool operator == (const static_entity& other) const{
+        return world_ == other.world_ && index_ == other.index_ && generation_ == other.generation_;
+    }
+
+    bool operator != (const static_entity& other) const{
+        return !(*this == other);
+    }
+
+protected:
+    /** the index may be reused by another entity already */
+    void check_valid() const{
+        if (!valid()){
+            throw std::runtime_error("static entity failed, the entity is destoryed");
+        }
+    }
+};
+
+/**
+ * @brief the group concept of the static world, the entitys that have all of Cs and none of the excluded,
+ * evaluated at iteration(no membership is stored)
+ */
+template<typename World, typename Include, typename Exclude>
+class static_view;
+
+template<typename World, typename... Cs, typename... Ns>
+class static_view<World, detail::type_list<Cs...>, detail::type_list<Ns...>>
+{
+public:
+    static const uint64_t all_of_mask = World::template mask<Cs...>::value;
+    static const uint64_t none_of_mask = World::template mask<Ns...>::value;
+
+protected:
+    World*  world_;
+
+public:
+    explicit static_view(World* world) : world_(world){}
+
+    /** exclude the entitys that have any of Es */
+    template<typename... Es>
+    static_view<World, detail::type_list<Cs...>, detail::type_list<Ns..., Es...>> without() const{
+        return static_view<World, detail::type_list<Cs...>, detail::type_list<Ns..., Es...>>(world_);
+    }
+
+    bool matches(uint32_t index) const{
+        uint64_t sig = world_->signature(index);
+        return (sig & all_of_mask) == all_of_mask && (sig & none_of_mask) == 0;
+    }
+
+    /**
+     * @brief visit the matched entitys, f(static_entity<World>, Cs&...)
+     * driven by the smallest storage of Cs, the visitor must not add/remove components or entitys
+     */
+    template<typename F>
+    void each(F f){
+        static_assert(sizeof...(Cs) > 0, "the view needs at least one component type to drive the iteration");
+        const uint32_t* indexs = nullptr;
+        uint32_t count = 0xffffffff;
+        int dummy[] = { 0, (pick_smaller<Cs>(indexs, count), 0)... };
+        (void)dummy;
+
+        for (uint32_t i = 0; i < count; ++i){
+            uint32_t index = indexs[i];
+            if (matches(index)){
+                f(world_->entity_at(index), world_->template storage<Cs>().get(index)...);
+            }
+        }
+    }
+
+    uint32_t entity_count(){
+        uint32_t n = 0;
+        each([&n](static_entity<World>, Cs&...){ ++n; });
+        return n;
+    }
+
+protected:
+    template<typename C>
+    void pick_smaller(const uint32_t*& indexs, uint32_t& count){
+        sparse_storage<C>& s = world_->template storage<C>();
+        if (s.size() < count){
+            indexs = s.indexs();
+            count = s.size();
+        }
+    }
+};
+
+template<typename... Cs>
+class static_world
+{
+public:
+    static_assert(sizeof...(Cs) <= 64, "the static world supports at most 64 component types");
+
+    typedef static_world<Cs...>         world_type;
+    typedef static_entity<world_type>   entity;
+
+    /** the compile-time component index */
+    template<typename C>
+    struct index : detail::index_of<C, Cs...>{
+        static_assert(detail::index_of<C, Cs...>::found, "the component is not in the static world");
+    };
+
+    /** the compile-time signature mask of the components */
+    template<typename... Ts>
+    struct mask : detail::mask_of<detail::type_list<Cs...>, Ts...>{};
+
+protected:
+    std::tuple<sparse_storage<Cs>...>   storages_;
+    std::vector<uint64_t>               signatures_;    // <entity index, component mask>
+    std::vector<uint32_t>               generations_;   // <entity index, generation>, odd if alive
+    std::vector<uint32_t>               free_indexs_;
+    uint32_t                            entity_count_;
+
+public:
+    static_world() : entity_count_(0){}
+    ~static_world(){}
+
+    static_world(const static_world&) = delete;
+    static_world& operator = (const static_world&) = delete;
+
+public:
+    entity  create_entity(){
+        uint32_t index = 0;
+        if (!free_indexs_.empty()){
+            index = free_indexs_.back();
+            free_indexs_.pop_back();
+        }
+        else{
+            index = (uint32_t)signatures_.size();
+            signatures_.push_back(0);
+            generations_.push_back(0);
+        }
+        ++generations_[index];
+        ++entity_count_;
+        return entity(this, index, generations_[index]);
+    }
+
+    void    destory(const entity& en){
+        if (!valid(en)){
+            return;
+        }
+
+        uint32_t index = en.index();
+        int dummy[] = { 0, (remove_component<Cs>(index), 0)... };
+        (void)dummy;
+
+        ++generations_[index];
+        free_indexs_.push_back(index);
+        --entity_count_;
+    }
+
+    bool    valid(const entity& en) const{
+        return en.index() < generations_.size() && generations_[en.index()] == en.generation() && (en.generation() & 1) != 0;
+    }
+
+    /** the handle of the alive entity at the index */
+    entity  entity_at(uint32_t index){
+        return entity(this, index, generations_[index]);
+    }
+
+    uint32_t entity_count() const{
+        return entity_count_;
+    }
+
+    uint64_t signature(uint32_t index) const{
+        return signatures_[index];
+    }
+
+    template<typename C>
+    sparse_storage<C>& storage(){
+        return std::get<index<C>::value>(storages_);
+    }
+
+    /**
+     * @brief the group concept, see static_view
+     */
+    template<typename... Components>
+    static_view<world_type, detail::type_list<Components...>, detail::type_list<>> view(){
+        return static_view<world_type, detail::type_list<Components...>, detail::type_list<>>(this);
+    }
+
+public:
+    template<typename C, typename... Args>
+    C&  add_component(uint32_t index, Args&& ...args){
+        C& comp = storage<C>().emplace(index, std::forward<Args>(args)...);
+        signatures_[index] |= mask<C>::value;
+        return comp;
+    }
+
+    template<typename C, typename... Args>
+    C&  replace_component(uint32_t index, Args&& ...args){
+        if (has_component<C>(index)){
+            C& comp = storage<C>().get(index);
+            comp = detail::make_component<C>(
+                std::integral_constant<bool, std::is_constructible<C, Args...>::value>(), std::forward<Args>(args)...);
+            return comp;
+        }
+        return add_component<C>(index, std::forward<Args>(args)...);
+    }
+
+    template<typename C>
+    void remove_component(uint32_t index){
+        if (has_component<C>(index)){
+            signatures_[index] &= ~mask<C>::value;
+            storage<C>().remove(index);
+        }
+    }
+
+    template<typename C>
+    bool has_component(uint32_t index) const{
+        return (signatures_[index] & mask<C>::value) != 0;
+    }
+
+    template<typename... Components>
+    bool has_components(uint32_t index) const{
+        return (signatures_[index] & mask<Components...>::value) == mask<Components...>::value;
+    }
+
+    template<typename C>
+    C*  get_component(uint32_t index){
+        return has_component<C>(index) ? &storage<C>().get(index) : nullptr;
+    }
+};
+
+/**
+ * @brief the systems of a static world, run in the declared order without virtual calls
+ * a system is a plain class with
+ *  void initialize(World& world);
+ *  void update(World& world, time_delta dt);
+ *  void fixed_update(World& world, time_delta dt);
+ */
+template<typename World, typename... Systems>
+class static_system_manager
+{
+protected:
+    std::tuple<Systems...>  systems_;
+
+public:
+    template<typename S>
+    S&  system(){
+        static_assert(detail::index_of<S, Systems...>::found, "the system is not in the static system manager");
+        return std::get<detail::index_of<S, Systems...>::value>(systems_);
+    }
+
+    void initialize(World& world){
+        int dummy[] = { 0, (system<Systems>().initialize(world), 0)... };
+        (void)dummy;
+    }
+
+    void update(World& world, time_delta dt){
+        int dummy[] = { 0, (system<Systems>().update(world, dt), 0)... };
+        (void)dummy;
+    }
+
+    void fixed_update(World& world, time_delta dt){
+        int dummy[] = { 0, (system<Systems>().fixed_update(world, dt), 0)... };
+        (void)dummy;
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -13,8 +13,12 @@
 #ifndef __ydk_ecs_system_hpp__
 #define __ydk_ecs_system_hpp__
 
+#include <ecs_cpp/context.hpp>
+#include <ecs_cpp/frame_allocator.hpp>
+#include <utility/profile/perf_counter.hpp>
 #include <unordered_map>
 #include <memory>
+#include <thread>
 
 namespace ecs_cpp{
 
@@ -32,17 +36,49 @@ public:
     virtual void fixed_update(time_delta dt) = 0;
 };
 
+/** the profile data of a system, only collected when the profiling is enabled */
+struct system_profile
+{
+    uint64_t                                update_count;
+    utility::profile::perf_counter_sample   update_total;
+    uint64_t                                fixed_update_count;
+    utility::profile::perf_counter_sample   fixed_update_total;
+
+    system_profile() : update_count(0), fixed_update_count(0){}
+};
+
 class system_manager
 {
 protected:
     std::unordered_map<uint32_t, system::ptr> systems_list_;
+
+    /** profiling */
+    bool                                            profiling_;
+    std::unique_ptr<utility::profile::perf_counter> perf_counter_;
+    std::thread::id                                 perf_counter_thread_;
+    std::unordered_map<uint32_t, system_profile>    system_profiles_;
+
+    /** rewound at the end of each update/fixed_update pass of all the systems, and by end_frame */
+    frame_allocator*                                frame_;
 public:
-    system_manager(){
+    system_manager() : profiling_(false), frame_(nullptr){
+    }
+
+    /**
+     * @brief the frame memory of the context is rewound after each update pass,
+     * the context must outlive the system manager
+     */
+    explicit system_manager(context& ctx) : profiling_(false), frame_(nullptr){
+        set_frame_allocator(&ctx.frame());
     }
 
     ~system_manager(){
+        set_frame_allocator(nullptr);
     }
 
+    system_manager(const system_manager&) = delete;
+    system_manager& operator = (const system_manager&) = delete;
+
 public:
     template<typename S>
     system_manager& add(std::shared_ptr<S> sys){
@@ -75,19 +111,26 @@ public:
         }
     }
 
+    /**
+     * @brief update one system, the frame memory is not rewound: a game that drives the systems
+     * one by one must call end_frame() once all the systems of the frame are updated
+     */
     template<typename S>
     void update(time_delta dt){
         std::shared_ptr<S> sys = system<S>();
         if (sys){
-            sys->update(dt);
+            update_system(typeid(S).hash_code(), sys.get(), dt);
         }
     }
 
+    /**
+     * @brief fixed update one system, the frame memory is not rewound, see update<S>
+     */
     template<typename S>
     void fixed_update(time_delta dt){
         std::shared_ptr<S> sys = system<S>();
         if (sys){
-            sys->fixed_update(dt);
+            fixed_update_system(typeid(S).hash_code(), sys.get(), dt);
         }
     }
 
@@ -99,14 +142,117 @@ public:
 
     void update(time_delta dt) {
         for (auto& sys_pair : systems_list_){
-            sys_pair.second->update(dt);
+            update_system(sys_pair.first, sys_pair.second.get(), dt);
         }
+        end_frame();
     }
 
     void fixed_update(time_delta dt) {
         for (auto& sys_pair : systems_list_){
-            sys_pair.second->fixed_update(dt);
+            fixed_update_system(sys_pair.first, sys_pair.second.get(), dt);
+        }
+        end_frame();
+    }
+
+    /**
+     * @brief rewind the frame memory, the memory allocated by the systems of the frame is invalid after it
+     * called by update/fixed_update of all the systems, call it after the per system updates
+     */
+    void end_frame(){
+        if (frame_){
+            frame_->reset();
+        }
+    }
+
+    /**
+     * @brief the frame memory(usually context::frame()) that the systems use, rewound after each pass
+     */
+    void set_frame_allocator(frame_allocator* frame){
+        if (frame_){
+            frame_->detach_manager();
+        }
+        frame_ = frame;
+        if (frame_){
+            frame_->attach_manager();
+        }
+    }
+
+public:
+    /**
+     * @brief enable/disable the per system profiling(wall time and hardware counters)
+     * the hardware counters are only captured if the perf counters are available,
+     * the counters are bound to a thread when opened, so they are opened lazily by the first
+     * profiled update, and reopened if the updates move to another thread
+     */
+    void enable_profiling(bool enable){
+        profiling_ = enable;
+    }
+
+    bool profiling_enabled() const{
+        return profiling_;
+    }
+
+    /** whether the hardware counters are captured, or only the wall time(known after the first profiled update) */
+    bool hardware_counters_available() const{
+        return perf_counter_ && perf_counter_->available();
+    }
+
+    template<typename S>
+    const system_profile* profile() const{
+        uint32_t type_id = typeid(S).hash_code();
+        auto iter = system_profiles_.find(type_id);
+        if (iter == system_profiles_.end()){
+            return nullptr;
+        }
+        return &iter->second;
+    }
+
+    /** <system type id, profile> */
+    const std::unordered_map<uint32_t, system_profile>& profiles() const{
+        return system_profiles_;
+    }
+
+    void reset_profiles(){
+        system_profiles_.clear();
+    }
+
+protected:
+    /** the counters of the calling thread */
+    utility::profile::perf_counter& thread_perf_counter(){
+        std::thread::id this_thread = std::this_thread::get_id();
+        if (!perf_counter_ || perf_counter_thread_ != this_thread){
+            perf_counter_.reset(new utility::profile::perf_counter());
+            perf_counter_thread_ = this_thread;
+        }
+        return *perf_counter_;
+    }
+
+    void update_system(uint32_t type_id, ecs_cpp::system* sys, time_delta dt){
+        if (!profiling_){
+            sys->update(dt);
+            return;
+        }
+
+        system_profile& prof = system_profiles_[type_id];
+        {
+            utility::profile::scoped_perf_sample sample(thread_perf_counter(), prof.update_total);
+            sys->update(dt);
+        }
+        ++prof.update_count;
+    }
+
+    void fixed_update_system(uint32_t type_id, ecs_cpp::system* sys, time_delta dt){
+        if (!profiling_){
+            sys->fixed_update(dt);
+            return;
+        }
+
+        system_profile& prof = system_profiles_[type_id];
+        {
+            utility::profile::scoped_perf_sample sample(thread_perf_counter(), prof.fixed_update_total);
+            sys->fixed_update(dt);
         }
+        ++prof.fixed_update_count;
     }
 };
 
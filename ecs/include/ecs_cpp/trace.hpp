@@ -0,0 +1,356 @@
+﻿/**
+ *
+ * a ecs framework implement of cpp
+ * file: trace.hpp
+ *
+ * record the structural operations(entity create/destory, component add/replace/remove)
+ * of a session into a compact binary trace, and replay the trace against a fresh context
+ *
+ * trace format:
+ *  header:  magic(u32) version(u32)
+ *  records: op(u8) entity_id(varint) [component_id(varint)] | op(u8)(tick, clear)
+ */
+
+#ifndef __ydk_ecs_trace_hpp__
+#define __ydk_ecs_trace_hpp__
+
+#include <ecs_cpp/context.hpp>
+#include <utility/io/binary_stream.hpp>
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+namespace ecs_cpp
+{
+enum trace_op
+{
+    trace_op_create_entity      = 1,
+    trace_op_destory_entity     = 2,
+    trace_op_add_component      = 3,
+    trace_op_replace_component  = 4,
+    trace_op_remove_component   = 5,
+    trace_op_tick               = 6,
+    trace_op_clear              = 7,    // entity_manager::clear, all the entitys are dropped
+};
+
+static const uint32_t trace_magic   = 0x54534345;   // "ECST"
+static const uint32_t trace_version = 1;
+
+class trace_recorder
+{
+protected:
+    entity_manager_iface*       entity_mgr_;
+    FILE*                       file_;
+    utility::io::binary_writer  writer_;
+    uint64_t                    record_count_;
+
+    /** flush the buffer to the file when the buffer size reach this */
+    static const std::size_t    flush_threshold = 64 * 1024;
+
+    event_subscriber<entity*>   entity_created_subscriber_;
+    event_subscriber<entity*>   entity_removed_subscriber_;
+    event_subscriber<>          cleared_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_added_subscriber_;
+    event_subscriber<entity*, component_id, void*, void*> component_replaced_subscriber_;
+    event_subscriber<entity*, component_id, void*> component_removed_subscriber_;
+
+public:
+    trace_recorder(entity_manager_iface* entity_mgr)
+        : entity_mgr_(entity_mgr)
+        , file_(nullptr)
+        , writer_(flush_threshold + 64)
+        , record_count_(0)
+    {
+        entity_created_subscriber_.register_event_handler(
+            std::bind(&trace_recorder::event_entity_created, this, std::placeholders::_1));
+        entity_removed_subscriber_.register_event_handler(
+            std::bind(&trace_recorder::event_entity_removed, this, std::placeholders::_1));
+        cleared_subscriber_.register_event_handler(
+            std::bind(&trace_recorder::event_cleared, this));
+        component_added_subscriber_.register_event_handler(
+            std::bind(&trace_recorder::event_component_added, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        component_replaced_subscriber_.register_event_handler(
+            std::bind(&trace_recorder::event_component_replaced, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+        component_removed_subscriber_.register_event_handler(
+            std::bind(&trace_recorder::event_component_removed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    ~trace_recorder(){
+        stop();
+    }
+
+public:
+    /**
+     * @brief start recording to the file, the file is truncated
+     * @return false if the file can't be opened
+     */
+    bool start(const std::string& path){
+        stop();
+
+        file_ = fopen(path.c_str(), "wb");
+        if (!file_){
+            return false;
+        }
+
+        record_count_ = 0;
+        writer_.clear();
+        writer_.write_u32(trace_magic);
+        writer_.write_u32(trace_version);
+
+        subscribe_events(1);
+        return true;
+    }
+
+    /**
+     * @brief stop recording, flush and close the file
+     */
+    void stop(){
+        if (!file_){
+            return;
+        }
+
+        subscribe_events(0);
+        flush();
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    bool recording() const{
+        return file_ != nullptr;
+    }
+
+    /**
+     * @brief mark the end of a tick, the replay reports the tick count
+     */
+    void mark_tick(){
+        if (file_){
+            writer_.write_u8(trace_op_tick);
+            write_done();
+        }
+    }
+
+    uint64_t record_count() const{
+        return record_count_;
+    }
+
+protected:
+    void subscribe_events(int32_t mode){
+        if (entity_mgr_){
+            entity_mgr_->subscribe_entity_create_event(&entity_created_subscriber_, mode);
+            entity_mgr_->subscribe_entity_remove_event(&entity_removed_subscriber_, mode);
+            entity_mgr_->subscribe_clear_event(&cleared_subscriber_, mode);
+            entity_mgr_->subscribe_component_added_event(&component_added_subscriber_, mode);
+            entity_mgr_->subscribe_component_replace_event(&component_replaced_subscriber_, mode);
+            entity_mgr_->subscribe_component_remove_event(&component_removed_subscriber_, mode);
+        }
+    }
+
+    void flush(){
+        if (file_ && writer_.size() > 0){
+            fwrite(writer_.data(), 1, writer_.size(), file_);
+            writer_.clear();
+        }
+    }
+
+    void write_done(){
+        ++record_count_;
+        if (writer_.size() >= flush_threshold){
+            flush();
+        }
+    }
+
+    void write_entity_op(trace_op op, entity* en){
+        writer_.write_u8((uint8_t)op);
+        writer_.write_varint((uint64_t)en->id());
+        write_done();
+    }
+
+    void write_component_op(trace_op op, entity* en, component_id id){
+        writer_.write_u8((uint8_t)op);
+        writer_.write_varint((uint64_t)en->id());
+        writer_.write_varint(id);
+        write_done();
+    }
+
+    void event_entity_created(entity* en){
+        write_entity_op(trace_op_create_entity, en);
+    }
+
+    void event_entity_removed(entity* en){
+        write_entity_op(trace_op_destory_entity, en);
+    }
+
+    void event_cleared(){
+        writer_.write_u8(trace_op_clear);
+        write_done();
+    }
+
+    void event_component_added(entity* en, component_id id, void* /*comp*/){
+        write_component_op(trace_op_add_component, en, id);
+    }
+
+    void event_component_replaced(entity* en, component_id id, void* /*old_comp*/, void* /*new_comp*/){
+        write_component_op(trace_op_replace_component, en, id);
+    }
+
+    void event_component_removed(entity* en, component_id id, void* /*comp*/){
+        write_component_op(trace_op_remove_component, en, id);
+    }
+};
+
+/** the result of a trace replay */
+struct trace_replay_result
+{
+    bool        ok;                     // false if the trace can't be read or is corrupted
+    uint64_t    op_count;               // replayed structural operations(tick marks excluded)
+    uint64_t    tick_count;
+    uint64_t    skipped_count;          // component operations of unregistered component types
+    double      seconds;
+
+    trace_replay_result()
+        : ok(false), op_count(0), tick_count(0), skipped_count(0), seconds(0){}
+
+    double ops_per_second() const{
+        return seconds > 0 ? op_count / seconds : 0;
+    }
+};
+
+class trace_replayer
+{
+protected:
+    typedef std::function<void(entity*)> component_factory;
+
+    /** <component type id, add/replace the component with the registered arguments> */
+    std::unordered_map<component_id, component_factory> component_factorys_;
+
+public:
+    /**
+     * @brief register the component type that the replay can create,
+     * the component is constructed with args each time it is added/replaced
+     */
+    template<typename C, typename ...Args>
+    trace_replayer& register_component(Args ... args){
+        component_factorys_[(component_id)typeid(C).hash_code()] = [=](entity* en){
+            en->replace_component<C>(args...);
+        };
+        return *this;
+    }
+
+    /**
+     * @brief replay the trace file against the context as fast as possible
+     * the file is loaded to the memory before the replay, the load time is not counted
+     */
+    trace_replay_result replay(const std::string& path, context& ctx){
+        trace_replay_result result;
+
+        std::vector<uint8_t> data;
+        if (!load_file(path, data)){
+            return result;
+        }
+        return replay(data.empty() ? nullptr : &data[0], data.size(), ctx);
+    }
+
+    trace_replay_result replay(const uint8_t* data, std::size_t size, context& ctx){
+        trace_replay_result result;
+        utility::io::binary_reader reader(data, size);
+
+        uint32_t magic = 0, version = 0;
+        if (!reader.read_u32(magic) || !reader.read_u32(version) || magic != trace_magic || version != trace_version){
+            return result;
+        }
+
+        /** <entity id in the trace, entity in the context> */
+        std::unordered_map<int64_t, entity*> entitys;
+
+        auto begin_time = std::chrono::steady_clock::now();
+        result.ok = true;
+        while (!reader.eof()){
+            uint8_t op = 0;
+            uint64_t entity_id = 0, comp_id = 0;
+            reader.read_u8(op);
+            if (op == trace_op_tick){
+                ++result.tick_count;
+                continue;
+            }
+            if (op == trace_op_clear){
+                ++result.op_count;
+                ctx.entity_admin.clear();
+                entitys.clear();
+                continue;
+            }
+
+            if (!reader.read_varint(entity_id) ||
+                (op >= trace_op_add_component && op <= trace_op_remove_component && !reader.read_varint(comp_id))){
+                result.ok = false;
+                break;
+            }
+
+            ++result.op_count;
+            if (op == trace_op_create_entity){
+                entitys[(int64_t)entity_id] = ctx.entity_admin.create_entity();
+                continue;
+            }
+
+            auto iter = entitys.find((int64_t)entity_id);
+            if (iter == entitys.end()){
+                // the entity is created before the recording
+                if (op == trace_op_destory_entity){
+                    continue;
+                }
+                iter = entitys.insert(std::make_pair((int64_t)entity_id, ctx.entity_admin.create_entity())).first;
+            }
+
+            entity* en = iter->second;
+            switch (op){
+            case trace_op_destory_entity:
+                en->destory();
+                entitys.erase(iter);
+                break;
+            case trace_op_add_component:
+            case trace_op_replace_component:{
+                auto factory_iter = component_factorys_.find((component_id)comp_id);
+                if (factory_iter != component_factorys_.end()){
+                    factory_iter->second(en);
+                }
+                else{
+                    ++result.skipped_count;
+                }
+                break;
+            }
+            case trace_op_remove_component:
+                en->remove_component((component_id)comp_id);
+                break;
+            default:
+                result.ok = false;
+                break;
+            }
+
+            if (!result.ok){
+                break;
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+        return result;
+    }
+
+protected:
+    static bool load_file(const std::string& path, std::vector<uint8_t>& data){
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f){
+            return false;
+        }
+
+        uint8_t buffer[64 * 1024];
+        std::size_t n = 0;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0){
+            data.insert(data.end(), buffer, buffer + n);
+        }
+        fclose(f);
+        return true;
+    }
+};
+}
+
+#endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 ﻿#include <ecs_cpp.hpp>
+#include <utility/profile/benchmark.hpp>
 #include <iostream>
 
 using namespace std;
@@ -39,12 +40,84 @@ public:
     }
 };
 
+/** plain struct components, no base class */
+struct health
+{
+    int32_t hp;
+    int32_t max_hp;
+};
+
+/** shared component, large and identical on many entitys */
+struct mesh_desc
+{
+    char    path[200];
+    int32_t lod;
+};
+
+/** indexed by the player id and the team */
+struct player
+{
+    int64_t player_id;
+    int32_t team;
+};
+
+/** unique component of the context */
+struct game_time
+{
+    float   delta;
+    int64_t frame;
+};
+
+/** tag component, no storage */
+struct stunned
+{
+};
+
+struct velocity
+{
+    float x;
+    float y;
+    float z;
+};
+
+template<>
+struct component_serializer<position>
+{
+    static void save(const position& comp, utility::io::binary_writer& writer){
+        writer.write_svarint(comp.x);
+        writer.write_svarint(comp.y);
+        writer.write_svarint(comp.z);
+    }
+
+    static position load(utility::io::binary_reader& reader){
+        int64_t x = 0, y = 0, z = 0;
+        reader.read_svarint(x);
+        reader.read_svarint(y);
+        reader.read_svarint(z);
+        return position((int32_t)x, (int32_t)y, (int32_t)z);
+    }
+};
+
+template<>
+struct component_serializer<speed>
+{
+    static void save(const speed& comp, utility::io::binary_writer& writer){
+        writer.write_svarint(comp.s);
+    }
+
+    static speed load(utility::io::binary_reader& reader){
+        int64_t s = 0;
+        reader.read_svarint(s);
+        return speed((int32_t)s);
+    }
+};
+
 void entity_comp_test()
 {
     context ecs_ctx;
 
     entity* en = ecs_ctx.entity_admin.create_entity();
-    printf("en id: %lld\n", en->id());
+    printf("en id: %lld\n", (long long)en->id());
     bool has_entity = en->has_component<position>();
     printf("has position component %d\n", has_entity);
     en->add_component<position>(1, 2, 3)
@@ -140,6 +213,11 @@ void mather_test(){
     group* none_group = ecs_ctx.entity_admin.get_group(mt_none);
     printf("group of mather none, entity count: %d\n", none_group->entity_count());
 
+    group* typed_all_group = ecs_ctx.entity_admin.get_group<all_of<speed, position, direction>>();
+    group* typed_mixed_group = ecs_ctx.entity_admin.get_group<all_of<position>, none_of<speed>>();
+    printf("typed group same as all group %d, mixed group entity count: %d, any matcher equals all matcher %d\n",
+        typed_all_group == all_group, typed_mixed_group->entity_count(), *mt_any == *mt_all);
+
     printf("remove components{position, direction, speed}\n");
     en->remove_component<position>()
         .remove_component<direction>()
@@ -148,11 +226,1080 @@ void mather_test(){
     ret = mt_none->matches(en);
     printf("match none %d after remove component{position, direction, speed}\n", ret);
 
+    // the group exists before the entity gets the components
+    entity* late_en = ecs_ctx.entity_admin.create_entity();
+    late_en->add_component<position>(1, 2, 3)
+        .add_component<direction>(4, 5, 6)
+        .add_component<speed>(1000);
+    printf("group of mather all, entity count: %d after a new entity gets the components\n", all_group->entity_count());
+    late_en->destory();
+
     en->destory();
 
     //::system("pause");
 }
 
+class move_system : public system
+{
+protected:
+    group* group_;
+public:
+    move_system(context& ctx)
+        : group_(ctx.entity_admin.get_group(matcher::all_of<position, direction>())){
+    }
+
+    virtual void initialize() override{}
+    virtual void fixed_update(time_delta /*dt*/) override{}
+    virtual void update(time_delta /*dt*/) override{
+        for (auto en : group_->entities()){
+            position* pos = en->get_component<position>();
+            direction* dir = en->get_component<direction>();
+            pos->x += dir->x;
+            pos->y += dir->y;
+            pos->z += dir->z;
+        }
+    }
+};
+
+void perf_counter_test(){
+    context ecs_ctx;
+    for (int32_t i = 0; i < 10000; ++i){
+        ecs_ctx.entity_admin.create_entity()
+            ->add_component<position>(i, i, i)
+            .add_component<direction>(1, 0, -1);
+    }
+
+    system_manager systems;
+    systems.add<move_system>(ecs_ctx);
+    systems.enable_profiling(true);
+    for (int32_t i = 0; i < 10; ++i){
+        systems.update(0.1);
+    }
+    printf("hardware counters available %d\n", systems.hardware_counters_available());
+
+    const system_profile* prof = systems.profile<move_system>();
+    printf("move_system updates: %llu, wall %llu ns, cycles %llu, llc misses %llu\n",
+        (unsigned long long)prof->update_count,
+        (unsigned long long)prof->update_total.wall_ns,
+        (unsigned long long)prof->update_total.values[utility::profile::pck_cycles],
+        (unsigned long long)prof->update_total.values[utility::profile::pck_llc_read_misses]);
+
+    // sample a group iteration directly
+    group* gp = ecs_ctx.entity_admin.get_group(matcher::all_of<position>());
+    utility::profile::perf_counter counter;
+    utility::profile::perf_counter_sample iter_sample;
+    int64_t sum = 0;
+    {
+        utility::profile::scoped_perf_sample s(counter, iter_sample);
+        for (auto en : gp->entities()){
+            sum += en->get_component<position>()->x;
+        }
+    }
+    printf("group iteration sum %lld, wall %llu ns\n", (long long)sum, (unsigned long long)iter_sample.wall_ns);
+
+    utility::profile::run_benchmark("create_destory_entity", 10000, [&](){
+        entity* en = ecs_ctx.entity_admin.create_entity();
+        en->add_component<position>(1, 2, 3);
+        en->destory();
+    }).print();
+}
+
+void trace_test(){
+    const char* trace_file = "ecs_trace_test.bin";
+    {
+        context ecs_ctx;
+        trace_recorder recorder(&ecs_ctx.entity_admin);
+        recorder.start(trace_file);
+        for (int32_t tick = 0; tick < 100; ++tick){
+            for (int32_t i = 0; i < 100; ++i){
+                entity* en = ecs_ctx.entity_admin.create_entity();
+                en->add_component<position>(i, i, i)
+                    .add_component<speed>(i);
+                en->replace_component<position>(i + 1, i, i);
+                en->remove_component<speed>();
+                if (i % 2 == 0){
+                    en->destory();
+                }
+            }
+            recorder.mark_tick();
+        }
+        recorder.stop();
+        printf("trace recorded %llu records, entity count %u\n",
+            (unsigned long long)recorder.record_count(), ecs_ctx.entity_admin.entity_count());
+    }
+
+    context replay_ctx;
+    trace_replayer replayer;
+    replayer.register_component<position>(0, 0, 0)
+        .register_component<speed>(0);
+    trace_replay_result result = replayer.replay(trace_file, replay_ctx);
+    printf("trace replay ok %d, ops %llu, ticks %llu, skipped %llu, %.0f ops/s, entity count %u\n",
+        result.ok, (unsigned long long)result.op_count, (unsigned long long)result.tick_count,
+        (unsigned long long)result.skipped_count, result.ops_per_second(), replay_ctx.entity_admin.entity_count());
+    remove(trace_file);
+}
+
+void snapshot_test(){
+    const char* snapshot_file = "ecs_snapshot_test.bin";
+    component_codec_registry registry;
+    registry.register_component<position>()
+        .register_component<speed>();
+
+    {
+        context ecs_ctx;
+        for (int32_t i = 0; i < 1000; ++i){
+            entity* en = ecs_ctx.entity_admin.create_entity();
+            en->add_component<position>(i, -i, i * 2);
+            if (i % 3 == 0){
+                en->add_component<speed>(i);
+            }
+            if (i % 5 == 0){
+                en->add_component<direction>(1, 1, 1);
+            }
+        }
+
+        snapshot snap(registry);
+        bool ok = snap.save(ecs_ctx, snapshot_file);
+        printf("snapshot save %d, entitys %llu, bytes %llu, skipped components %llu\n", ok,
+            (unsigned long long)snap.stats().entity_count, (unsigned long long)snap.stats().byte_count,
+            (unsigned long long)snap.stats().skipped_component_count);
+    }
+
+    context load_ctx;
+    group* speed_group = load_ctx.entity_admin.get_group(matcher::all_of<position, speed>());
+    snapshot snap(registry);
+    bool ok = snap.load(load_ctx, snapshot_file);
+    entity* en = load_ctx.entity_admin.get_entity(301);
+    position* pos = en ? en->get_component<position>() : nullptr;
+    printf("snapshot load %d, entity count %u, speed group count %u, entity 301 position {%d, %d, %d}\n",
+        ok, load_ctx.entity_admin.entity_count(), speed_group->entity_count(),
+        pos ? pos->x : 0, pos ? pos->y : 0, pos ? pos->z : 0);
+    printf("next entity id after load %lld\n", (long long)load_ctx.entity_admin.create_entity()->id());
+    remove(snapshot_file);
+
+    // a snapshot with a duplicate entity id is rejected
+    context dup_ctx;
+    dup_ctx.entity_admin.create_entity()->add_component<position>(1, 1, 1);
+    dup_ctx.entity_admin.create_entity()->add_component<position>(2, 2, 2);
+    utility::io::binary_writer writer;
+    snapshot(registry).save(dup_ctx, writer);
+    std::vector<uint8_t> bytes(writer.data(), writer.data() + writer.size());
+    memcpy(&bytes[40], &bytes[32], 8);     // the id of the second entity = the id of the first
+    context dup_load_ctx;
+    ok = snapshot(registry).load(dup_load_ctx, &bytes[0], bytes.size());
+    printf("snapshot duplicate id load %d, entity count %u\n", ok, dup_load_ctx.entity_admin.entity_count());
+}
+
+void replication_test(){
+    component_codec_registry registry;
+    registry.register_component<position>()
+        .register_component<speed>();
+
+    context server_ctx;
+    context client_ctx;
+    std::vector<entity*> ens;
+    for (int32_t i = 0; i < 100; ++i){
+        entity* en = server_ctx.entity_admin.create_entity();
+        en->add_component<position>(i, i, i);
+        ens.push_back(en);
+    }
+
+    delta_encoder encoder(server_ctx.entity_admin, registry);
+    delta_decoder decoder(client_ctx, registry);
+    utility::io::binary_writer writer;
+    for (int32_t tick = 0; tick < 5; ++tick){
+        // move a few entitys, change a speed, destory one and create one
+        for (int32_t i = 0; i < 10; ++i){
+            position* pos = ens[i]->get_component<position>();
+            ens[i]->replace_component<position>(pos->x + 1, pos->y, pos->z);
+        }
+        ens[tick]->replace_component<speed>(tick);
+        ens[50 + tick]->remove_component<position>();
+        ens[90 + tick]->destory();
+        ens[90 + tick] = server_ctx.entity_admin.create_entity();
+        ens[90 + tick]->add_component<position>(tick, tick, tick);
+
+        writer.clear();
+        encoder.encode(writer);
+        bool ok = decoder.apply(writer.data(), writer.size());
+        const delta_stats& st = encoder.stats();
+        printf("delta tick %llu apply %d, bytes %llu, created %u, destoryed %u, full %u, patch %u, remove %u\n",
+            (unsigned long long)st.tick, ok, (unsigned long long)st.byte_count, st.created_count,
+            st.destoryed_count, st.full_count, st.patch_count, st.remove_count);
+    }
+
+    entity* replica = decoder.local_entity(ens[3]->id());
+    position* pos = replica->get_component<position>();
+    speed* spd = replica->get_component<speed>();
+    printf("replica entity count %u(server %u), position {%d, %d, %d}, speed %d\n",
+        client_ctx.entity_admin.entity_count(), server_ctx.entity_admin.entity_count(),
+        pos->x, pos->y, pos->z, spd->s);
+
+    // a truncated delta is rejected without advancing the tick, the client resyncs from a new encoder
+    ens[0]->replace_component<speed>(100);
+    writer.clear();
+    encoder.encode(writer);
+    bool truncated_ok = decoder.apply(writer.data(), writer.size() / 2);
+    uint64_t failed_tick = decoder.tick();
+    decoder.reset();
+    delta_encoder resync_encoder(server_ctx.entity_admin, registry);
+    writer.clear();
+    resync_encoder.encode(writer);
+    bool resync_ok = decoder.apply(writer.data(), writer.size());
+    printf("truncated delta apply %d, tick %llu, resync %d, replica entity count %u, speed %d\n",
+        truncated_ok, (unsigned long long)failed_tick, resync_ok, client_ctx.entity_admin.entity_count(),
+        decoder.local_entity(ens[0]->id())->get_component<speed>()->s);
+}
+
+void journal_test(){
+    const char* snapshot_file = "ecs_journal_test.snap";
+    const char* journal_file = "ecs_journal_test.journal";
+    const char* compact_file = "ecs_journal_test_compact.snap";
+    component_codec_registry registry;
+    registry.register_component<position>()
+        .register_component<speed>();
+
+    int64_t moved_id = 0;
+    {
+        context ecs_ctx;
+        for (int32_t i = 0; i < 100; ++i){
+            ecs_ctx.entity_admin.create_entity()->add_component<position>(i, i, i);
+        }
+        snapshot(registry).save(ecs_ctx, snapshot_file);
+
+        journal_writer journal(ecs_ctx.entity_admin, registry, journal_sync_interval, 5);
+        journal.open(journal_file);
+        entity* en = ecs_ctx.entity_admin.create_entity();
+        moved_id = en->id();
+        for (int32_t tick = 0; tick < 10; ++tick){
+            en->replace_component<position>(tick, tick * 2, tick * 3);
+            ecs_ctx.entity_admin.get_entity(tick + 1)->destory();
+            journal.commit_tick();
+        }
+        bool flushed = journal.flush();
+        printf("journal flush %d, durable tick %llu\n", flushed, (unsigned long long)journal.durable_tick());
+
+#if !defined(_WIN32)
+        // the disk is always full, the journal must not claim durability
+        journal_writer full_journal(ecs_ctx.entity_admin, registry);
+        printf("journal open on a full disk %d, commit %d\n", full_journal.open("/dev/full"), full_journal.commit_tick());
+#endif
+
+        // not committed, lost in the "crash"
+        en->add_component<speed>(100);
+    }
+
+    context recover_ctx;
+    snapshot(registry).load(recover_ctx, snapshot_file);
+    journal_replay_result result = journal_replayer(registry).replay(recover_ctx, journal_file);
+    entity* en = recover_ctx.entity_admin.get_entity(moved_id);
+    position* pos = en ? en->get_component<position>() : nullptr;
+    printf("journal replay ok %d, ticks %llu, records %llu, dropped bytes %llu, entity count %u, position {%d, %d, %d}, has speed %d\n",
+        result.ok, (unsigned long long)result.tick_count, (unsigned long long)result.record_count,
+        (unsigned long long)result.dropped_bytes, recover_ctx.entity_admin.entity_count(),
+        pos ? pos->x : 0, pos ? pos->y : 0, pos ? pos->z : 0, en ? en->has_component<speed>() : 0);
+
+    bool ok = journal_compact(registry, snapshot_file, journal_file, compact_file);
+    context compact_ctx;
+    snapshot(registry).load(compact_ctx, compact_file);
+    printf("journal compact %d, entity count %u\n", ok, compact_ctx.entity_admin.entity_count());
+
+    // a committed record whose payload the codec rejects stops the replay
+    utility::io::binary_writer create_record, set_record, commit_record, corrupt;
+    create_record.write_u8(journal_op_create_entity);
+    create_record.write_varint(1);
+    set_record.write_u8(journal_op_set_component);
+    set_record.write_varint(1);
+    set_record.write_varint((component_id)typeid(position).hash_code());
+    set_record.write_varint(1);
+    set_record.write_svarint(2);    // only x, y and z are missing
+    commit_record.write_u8(journal_op_commit_tick);
+    commit_record.write_varint(1);
+    corrupt.write_u32(journal_magic);
+    corrupt.write_u32(journal_version);
+    for (utility::io::binary_writer* record : { &create_record, &set_record, &commit_record }){
+        corrupt.write_u32((uint32_t)record->size());
+        corrupt.write_u32(detail::fnv1a(record->data(), record->size()));
+        corrupt.write_bytes(record->data(), record->size());
+    }
+    FILE* f = fopen(journal_file, "wb");
+    fwrite(corrupt.data(), 1, corrupt.size(), f);
+    fclose(f);
+    context corrupt_ctx;
+    result = journal_replayer(registry).replay(corrupt_ctx, journal_file);
+    en = corrupt_ctx.entity_admin.get_entity(1);
+    printf("journal corrupt payload replay ok %d, ticks %llu, has position %d\n",
+        result.ok, (unsigned long long)result.tick_count, en ? en->has_component<position>() : 0);
+
+    remove(snapshot_file);
+    remove(journal_file);
+    remove(compact_file);
+}
+
+void pod_component_test(){
+    printf("sizeof position %u, sizeof velocity %u, velocity trivially copyable %d\n",
+        (uint32_t)sizeof(position), (uint32_t)sizeof(velocity), std::is_trivially_copyable<velocity>::value);
+
+    const char* snapshot_file = "ecs_pod_test.snap";
+    component_codec_registry registry;
+    registry.register_component<health>()
+        .register_component<velocity>();
+
+    {
+        context ecs_ctx;
+        group* gp = ecs_ctx.entity_admin.get_group(matcher::all_of<health, velocity>());
+        for (int32_t i = 0; i < 100; ++i){
+            ecs_ctx.entity_admin.create_entity()
+                ->add_component<health>(i, 100)
+                .add_component<velocity>(1.0f, 2.0f, (float)i);
+        }
+        entity* en = ecs_ctx.entity_admin.get_entity(10);
+        en->replace_component<health>(50, 100);
+        component_handle<health> hp(en);
+        printf("pod group count %u, hp %d/%d, sibling velocity z %.1f\n",
+            gp->entity_count(), hp->hp, hp->max_hp, hp.sibling<velocity>()->z);
+
+        snapshot snap(registry);
+        snap.save(ecs_ctx, snapshot_file);
+        printf("pod snapshot column sections %u, bytes %llu\n",
+            snap.stats().column_section_count, (unsigned long long)snap.stats().byte_count);
+    }
+
+    context load_ctx;
+    snapshot snap(registry);
+    bool ok = snap.load(load_ctx, snapshot_file);
+    health* hp = load_ctx.entity_admin.get_entity(10)->get_component<health>();
+    printf("pod snapshot load %d, column sections %u, hp %d/%d\n", ok, snap.stats().column_section_count, hp->hp, hp->max_hp);
+    remove(snapshot_file);
+}
+
+void tag_component_test(){
+    const char* snapshot_file = "ecs_tag_test.snap";
+    component_codec_registry registry;
+    registry.register_component<health>()
+        .register_component<stunned>();
+
+    {
+        context ecs_ctx;
+        group* stunned_gp = ecs_ctx.entity_admin.get_group(matcher::all_of<health, stunned>());
+        group* active_gp = ecs_ctx.entity_admin.get_group(matcher::none_of<stunned>());
+        for (int32_t i = 0; i < 1000; ++i){
+            ecs_ctx.entity_admin.create_entity()->add_component<health>(i, 100);
+        }
+
+        // toggle the tag every frame
+        for (int32_t frame = 0; frame < 10; ++frame){
+            for (int32_t i = 1; i <= 1000; ++i){
+                entity* en = ecs_ctx.entity_admin.get_entity(i);
+                if ((i + frame) % 2 == 0){
+                    en->replace_component<stunned>();
+                }
+                else{
+                    en->remove_component<stunned>();
+                }
+            }
+        }
+
+        entity* en = ecs_ctx.entity_admin.get_entity(10);
+        printf("tag stunned group %u, active group %u, entity 10 stunned %d, component count %u\n",
+            stunned_gp->entity_count(), active_gp->entity_count(), en->has_component<stunned>(), en->component_count());
+
+        snapshot snap(registry);
+        snap.save(ecs_ctx, snapshot_file);
+        printf("tag snapshot bytes %llu\n", (unsigned long long)snap.stats().byte_count);
+    }
+
+    context load_ctx;
+    snapshot snap(registry);
+    bool ok = snap.load(load_ctx, snapshot_file);
+    group* gp = load_ctx.entity_admin.get_group(matcher::all_of<stunned>());
+    printf("tag snapshot load %d, stunned group %u\n", ok, gp->entity_count());
+    remove(snapshot_file);
+}
+
+void unique_component_test(){
+    context ecs_ctx;
+    ecs_ctx.set_unique<game_time>(0.016f, 0);
+
+    uint64_t seen_version = 0;
+    int32_t changed_count = 0;
+    for (int32_t frame = 1; frame <= 100; ++frame){
+        if (frame % 10 == 0){
+            ecs_ctx.patch_unique<game_time>([frame](game_time& t){ t.frame = frame; });
+        }
+
+        // a system checks the change each tick
+        if (ecs_ctx.unique_changed_since<game_time>(seen_version)){
+            seen_version = ecs_ctx.unique_version<game_time>();
+            ++changed_count;
+        }
+    }
+
+    // replaced with the aggregate fields
+    ecs_ctx.set_unique<game_time>(0.033f, 200);
+    printf("unique game_time frame %lld, changed %d, has stunned %d\n",
+        (long long)ecs_ctx.unique<game_time>().frame, changed_count, ecs_ctx.has_unique<stunned>());
+}
+
+void composite_query_test(){
+    context ecs_ctx;
+    for (int32_t i = 0; i < 10000; ++i){
+        entity* en = ecs_ctx.entity_admin.create_entity();
+        en->add_component<health>(i, 100);
+        if (i % 100 == 0){
+            en->add_component<velocity>(1.0f, 0.0f, 0.0f);
+        }
+        if (i % 200 == 0){
+            en->add_component<stunned>();
+        }
+        if (i % 3 == 0){
+            en->add_component<speed>(i);
+        }
+    }
+
+    // driven from the 100 velocity entitys, not the 10000 health ones
+    uint32_t moving = 0;
+    ecs_ctx.entity_admin.query(all_of<health, velocity>().none_of<stunned>(), [&](entity* /*en*/){
+        ++moving;
+    });
+
+    uint32_t any_count = 0;
+    ecs_ctx.entity_admin.query(any_of<velocity, stunned>().all_of<speed>(), [&](entity* /*en*/){
+        ++any_count;
+    });
+
+    group* gp = ecs_ctx.entity_admin.get_group(all_of<health, velocity>().none_of<stunned>());
+    printf("composite query moving %u, any of velocity/stunned with speed %u, group %u\n", moving, any_count, gp->entity_count());
+
+    // one-shot query, no group is registered
+    uint32_t group_count = ecs_ctx.entity_admin.group_count();
+    int64_t hp_sum = 0;
+    ecs_ctx.entity_admin.query<health, velocity>([&](entity* /*en*/, health* hp, velocity* /*vel*/){
+        hp_sum += hp->hp;
+    });
+
+    group* temp_gp = ecs_ctx.entity_admin.acquire_group(matcher::all_of<speed>());
+    uint32_t speed_count = temp_gp->entity_count();
+    uint32_t count_with_temp = ecs_ctx.entity_admin.group_count();
+    ecs_ctx.entity_admin.release_group(temp_gp);
+    printf("query hp sum %lld, groups %u, with the acquired group %u(speed %u), after release %u\n",
+        (long long)hp_sum, group_count, count_with_temp, speed_count, ecs_ctx.entity_admin.group_count());
+
+    group* typed_gp = ecs_ctx.entity_admin.acquire_group(all_of<speed>().none_of<stunned>());
+    uint32_t count_with_typed = ecs_ctx.entity_admin.group_count();
+    ecs_ctx.entity_admin.release_group(typed_gp);
+    printf("typed acquired group count %u, after release %u\n", count_with_typed, ecs_ctx.entity_admin.group_count());
+}
+
+void group_population_test(){
+    context ecs_ctx;
+
+    // pre-registered, built as the entitys arrive
+    group* pre_gp = ecs_ctx.entity_admin.get_group<all_of<health>>();
+    for (int32_t i = 0; i < 10000; ++i){
+        entity* en = ecs_ctx.entity_admin.create_entity();
+        en->add_component<health>(i, 100);
+        if (i % 2 == 0){
+            en->add_component<velocity>(1.0f, 0.0f, 0.0f);
+        }
+    }
+
+    group* lazy_gp = ecs_ctx.entity_admin.get_group(matcher::all_of<velocity>(), group_populate_lazy);
+    bool lazy_ready = lazy_gp->ready();
+    uint32_t lazy_count = lazy_gp->entity_count();
+
+    group* warm_gp = ecs_ctx.entity_admin.get_group(matcher::all_of<health, velocity>(), group_populate_incremental);
+    int32_t ticks = 0;
+    while (!ecs_ctx.entity_admin.warm_groups(1000)){
+        ++ticks;
+        // the changes during the warming are matched by the events
+        ecs_ctx.entity_admin.get_entity(ticks)->remove_component<health>();
+    }
+    printf("group population pre-registered %u, lazy ready %d count %u, warmed in %d ticks count %u\n",
+        pre_gp->entity_count(), lazy_ready, lazy_count, ticks, warm_gp->entity_count());
+}
+
+void entity_index_test(){
+    context ecs_ctx;
+    entity_unique_index<player, int64_t> by_player_id(ecs_ctx.entity_admin, [](const player& p){ return p.player_id; });
+    for (int32_t i = 0; i < 1000; ++i){
+        ecs_ctx.entity_admin.create_entity()->add_component<player>(10000 + i, i % 4);
+    }
+
+    // built on the existing entitys
+    entity_index<player, int32_t> by_team(ecs_ctx.entity_admin, [](const player& p){ return p.team; });
+
+    entity* en = by_player_id.find(10500);
+    en->replace_component<player>(10500, 7);
+    ecs_ctx.entity_admin.get_entity(1)->destory();
+    ecs_ctx.entity_admin.get_entity(2)->remove_component<player>();
+
+    printf("entity index player 10500 -> entity %lld, player 10000 found %d, team 0 count %u, team 7 count %u, indexed %u\n",
+        (long long)en->id(), by_player_id.find(10000) != nullptr, by_team.count(0), by_team.count(7), by_team.entity_count());
+}
+
+void sorted_group_test(){
+    context ecs_ctx;
+    for (int32_t i = 0; i < 1000; ++i){
+        ecs_ctx.entity_admin.create_entity()->add_component<health>((i * 7919) % 1000, 100);
+    }
+
+    sorted_group<health, int32_t> by_hp(ecs_ctx.entity_admin, matcher::all_of<health>(), [](const health& hp){ return hp.hp; });
+
+    // the keys change and the members come and go, the order is kept incrementally
+    for (int32_t i = 1; i <= 1000; i += 3){
+        ecs_ctx.entity_admin.get_entity(i)->replace_component<health>((i * 31) % 1000, 100);
+    }
+    for (int32_t i = 2; i <= 1000; i += 10){
+        ecs_ctx.entity_admin.get_entity(i)->remove_component<health>();
+    }
+    ecs_ctx.entity_admin.create_entity()->add_component<health>(-1, 100);
+
+    bool ordered = true;
+    int32_t prev = -2;
+    by_hp.for_each([&](entity* en){
+        int32_t hp = en->get_component<health>()->hp;
+        ordered = ordered && prev <= hp;
+        prev = hp;
+    });
+    printf("sorted group count %u, ordered %d, first hp %d\n",
+        by_hp.entity_count(), ordered, by_hp.items().front().key);
+}
+
+void spatial_grid_test(){
+    context ecs_ctx;
+    spatial_grid<position> grid(ecs_ctx.entity_admin, 16.0f, [](const position& pos){
+        return spatial_point((float)pos.x, (float)pos.y, (float)pos.z);
+    });
+
+    // a 100 x 100 plane, 4 units apart
+    for (int32_t i = 0; i < 10000; ++i){
+        ecs_ctx.entity_admin.create_entity()->add_component<position>((i % 100) * 4, (i / 100) * 4, 0);
+    }
+    ecs_ctx.entity_admin.get_entity(1)->replace_component<position>(1000, 1000, 0);
+
+    std::vector<entity*> in_radius, in_box, nearest;
+    grid.query_radius(spatial_point(200, 200, 0), 8.0f, in_radius);
+    grid.query_aabb(spatial_point(0, 0, 0), spatial_point(10, 10, 0), in_box);
+    grid.query_nearest(spatial_point(1001, 1001, 0), 3, nearest);
+
+    // check the radius query against a scan
+    uint32_t scan_count = 0;
+    ecs_ctx.entity_admin.query<position>([&](entity* /*en*/, position* pos){
+        float dx = pos->x - 200.0f, dy = pos->y - 200.0f;
+        scan_count += (dx * dx + dy * dy <= 64.0f) ? 1 : 0;
+    });
+    position* far_pos = nearest[1]->get_component<position>();
+    printf("spatial grid radius %u(scan %u), box %u, nearest %lld then {%d, %d}\n",
+        (uint32_t)in_radius.size(), scan_count, (uint32_t)in_box.size(), (long long)nearest[0]->id(), far_pos->x, far_pos->y);
+}
+
+void patch_component_test(){
+    context ecs_ctx;
+    for (int32_t i = 0; i < 1000; ++i){
+        ecs_ctx.entity_admin.create_entity()->add_component<health>(i, 100);
+    }
+    sorted_group<health, int32_t> by_hp(ecs_ctx.entity_admin, matcher::all_of<health>(), [](const health& hp){ return hp.hp; });
+
+    uint32_t changed_count = 0;
+    event_subscriber<entity*, component_id, void*> changed_sub;
+    changed_sub.register_event_handler([&](entity* /*en*/, component_id /*id*/, void* /*comp*/){ ++changed_count; });
+    ecs_ctx.entity_admin.subscribe_component_change_event(&changed_sub, 1);
+
+    // the changed feed of a group, only the members
+    group* gp = ecs_ctx.entity_admin.get_group<all_of<health>>();
+    uint32_t group_changed_count = 0;
+    event_subscriber<entity*, component_id, void*> group_changed_sub;
+    group_changed_sub.register_event_handler([&](entity* /*en*/, component_id /*id*/, void* /*comp*/){ ++group_changed_count; });
+    gp->subscribe_entity_changed_event(&group_changed_sub, 1);
+
+    // mutated in place, the address is stable and the sorted group follows the change events
+    entity* en = ecs_ctx.entity_admin.get_entity(1);
+    health* before = en->get_component<health>();
+    for (int32_t i = 0; i < 100; ++i){
+        en->patch_component<health>([](health& hp){ hp.hp += 20; });
+    }
+    ecs_ctx.entity_admin.get_entity(2)->get_component<health>()->hp = -5;
+    ecs_ctx.entity_admin.get_entity(2)->mark_changed<health>();
+    ecs_ctx.entity_admin.subscribe_component_change_event(&changed_sub, 0);
+    gp->subscribe_entity_changed_event(&group_changed_sub, 0);
+
+    printf("patch component stable address %d, hp %d, changed %u, group changed %u, sorted first %lld last %lld\n",
+        before == en->get_component<health>(), en->get_component<health>()->hp, changed_count, group_changed_count,
+        (long long)by_hp.items().front().en->id(), (long long)by_hp.items().back().en->id());
+
+    // an interned value is never written in place
+    mesh_desc mesh;
+    sprintf(mesh.path, "tree.mesh");
+    mesh.lod = 0;
+    entity* shared_en = ecs_ctx.entity_admin.get_entity(3);
+    shared_en->add_shared_component<mesh_desc>(mesh);
+    bool shared_rejected = false;
+    try{
+        shared_en->mark_changed<mesh_desc>();
+    }
+    catch (const std::runtime_error&){
+        shared_rejected = true;
+    }
+    printf("mark changed of a shared component rejected %d\n", shared_rejected);
+}
+
+void entity_enable_test(){
+    context ecs_ctx;
+    group* gp = ecs_ctx.entity_admin.get_group<all_of<health, velocity>>();
+    for (int32_t i = 0; i < 10000; ++i){
+        entity* en = ecs_ctx.entity_admin.create_entity();
+        en->add_component<health>(i, 100);
+        en->add_component<velocity>(1.0f, 0.0f, 0.0f);
+    }
+
+    // park half of the npcs, the components stay
+    for (int32_t i = 1; i <= 5000; ++i){
+        ecs_ctx.entity_admin.get_entity(i)->set_enabled(false);
+    }
+    uint32_t query_count = 0;
+    ecs_ctx.entity_admin.query<health>([&](entity* /*en*/, health* /*hp*/){ ++query_count; });
+    uint32_t enabled_count = gp->entity_count();
+    uint32_t disabled_count = gp->disabled_entity_count();
+    enabled_entity_view view = gp->entities();
+    uint32_t iterated_count = (uint32_t)std::distance(view.begin(), view.end());
+
+    // the toggle only flips the flag and a counter per group, no node is allocated
+    auto bench = utility::profile::run_benchmark("entity enable toggle", 100, [&](){
+        for (int32_t i = 5001; i <= 10000; ++i){
+            ecs_ctx.entity_admin.get_entity(i)->set_enabled(false);
+        }
+        for (int32_t i = 5001; i <= 10000; ++i){
+            ecs_ctx.entity_admin.get_entity(i)->set_enabled(true);
+        }
+    });
+    bench.print();
+
+    // a parked entity still follows the structural changes
+    ecs_ctx.entity_admin.get_entity(1)->remove_component<velocity>();
+    for (int32_t i = 1; i <= 5000; ++i){
+        ecs_ctx.entity_admin.get_entity(i)->set_enabled(true);
+    }
+    printf("entity enable parked group %u(disabled %u, iterated %u), query %u, unparked group %u(disabled %u)\n",
+        enabled_count, disabled_count, iterated_count, query_count, gp->entity_count(), gp->disabled_entity_count());
+}
+
+void entity_enable_persist_test(){
+    const char* snapshot_file = "ecs_enable_test.snap";
+    const char* journal_file = "ecs_enable_test.journal";
+    component_codec_registry registry;
+    registry.register_component<health>()
+        .register_component<velocity>();
+
+    context ecs_ctx;
+    for (int32_t i = 0; i < 10; ++i){
+        ecs_ctx.entity_admin.create_entity()
+            ->add_component<health>(i, 100)
+            .add_component<velocity>(1.0f, 0.0f, 0.0f);
+    }
+    ecs_ctx.entity_admin.get_entity(1)->set_enabled(false);
+
+    // the first delta carries the flag of the existing entitys
+    context client_ctx;
+    delta_encoder encoder(ecs_ctx.entity_admin, registry);
+    delta_decoder decoder(client_ctx, registry);
+    utility::io::binary_writer writer;
+    encoder.encode(writer);
+    bool delta_ok = decoder.apply(writer.data(), writer.size());
+    bool replica_disabled = !decoder.local_entity(1)->enabled();
+
+    snapshot(registry).save(ecs_ctx, snapshot_file);
+    journal_writer journal(ecs_ctx.entity_admin, registry);
+    journal.open(journal_file);
+    ecs_ctx.entity_admin.get_entity(1)->set_enabled(true);
+    ecs_ctx.entity_admin.get_entity(2)->set_enabled(false);
+    journal.commit_tick();
+    journal.flush();
+    journal.close();
+
+    writer.clear();
+    encoder.encode(writer);
+    delta_ok = decoder.apply(writer.data(), writer.size()) && delta_ok;
+
+    context snapshot_ctx;
+    group* snapshot_group = snapshot_ctx.entity_admin.get_group<all_of<health, velocity>>();
+    bool snapshot_ok = snapshot(registry).load(snapshot_ctx, snapshot_file);
+
+    context recover_ctx;
+    snapshot(registry).load(recover_ctx, snapshot_file);
+    journal_replay_result result = journal_replayer(registry).replay(recover_ctx, journal_file);
+
+    printf("enable round trip snapshot %d(entity 1 enabled %d, group %u), journal %d(entity 1 enabled %d, entity 2 enabled %d), "
+        "delta %d(entity 1 disabled %d, then entity 1 enabled %d, entity 2 enabled %d)\n",
+        snapshot_ok, snapshot_ctx.entity_admin.get_entity(1)->enabled(), snapshot_group->entity_count(),
+        result.ok, recover_ctx.entity_admin.get_entity(1)->enabled(), recover_ctx.entity_admin.get_entity(2)->enabled(),
+        delta_ok, replica_disabled, decoder.local_entity(1)->enabled(), decoder.local_entity(2)->enabled());
+
+    remove(snapshot_file);
+    remove(journal_file);
+}
+
+void world_clear_test(){
+    context ecs_ctx;
+    group* gp = ecs_ctx.entity_admin.get_group<all_of<health, velocity>>();
+    entity_index<player, int32_t> by_team(ecs_ctx.entity_admin, [](const player& p){ return p.team; });
+    mesh_desc desc[8];
+    memset(desc, 0, sizeof(desc));
+    for (int32_t i = 0; i < 8; ++i){
+        sprintf(desc[i].path, "mesh/npc_%d.mesh", i);
+    }
+
+    for (int32_t round = 0; round < 3; ++round){
+        for (int32_t i = 0; i < 10000; ++i){
+            entity* en = ecs_ctx.entity_admin.create_entity();
+            en->add_component<health>(i, 100);
+            en->add_component<velocity>(1.0f, 0.0f, 0.0f);
+            en->add_component<player>(i, i % 4);
+            en->add_shared_component<mesh_desc>(desc[i % 8]);
+        }
+        if (round < 2){
+            ecs_ctx.entity_admin.clear();
+        }
+    }
+
+    // the pools are reused by the later rounds
+    memory_pool_type* pool = ecs_ctx.entity_admin.get_component_pool((component_id)typeid(health).hash_code());
+    printf("world clear entitys %u, group %u, team 0 count %u, meshes %u, health pool cells %u\n",
+        ecs_ctx.entity_admin.entity_count(), gp->entity_count(), by_team.count(0),
+        (uint32_t)ecs_ctx.entity_admin.shared_value_count<mesh_desc>(), pool->total_cell_count());
+
+    // the journal and the trace record the clear, the replays don't bring the cleared entitys back
+    const char* journal_file = "ecs_clear_test.journal";
+    const char* trace_file = "ecs_clear_test.trace";
+    component_codec_registry registry;
+    registry.register_component<position>();
+    {
+        context record_ctx;
+        journal_writer journal(record_ctx.entity_admin, registry);
+        journal.open(journal_file);
+        trace_recorder recorder(&record_ctx.entity_admin);
+        recorder.start(trace_file);
+        for (int32_t round = 0; round < 2; ++round){
+            for (int32_t i = 0; i < 10 - round * 5; ++i){
+                record_ctx.entity_admin.create_entity()->add_component<position>(i, i, i);
+            }
+            if (round == 0){
+                record_ctx.entity_admin.clear();
+            }
+            journal.commit_tick();
+        }
+        journal.flush();
+        recorder.stop();
+    }
+
+    context journal_ctx;
+    journal_replay_result journal_result = journal_replayer(registry).replay(journal_ctx, journal_file);
+    context trace_ctx;
+    trace_replayer replayer;
+    replayer.register_component<position>(0, 0, 0);
+    trace_replay_result trace_result = replayer.replay(trace_file, trace_ctx);
+    printf("world clear journal replay %d entitys %u, trace replay %d entitys %u\n",
+        journal_result.ok, journal_ctx.entity_admin.entity_count(), trace_result.ok, trace_ctx.entity_admin.entity_count());
+    remove(journal_file);
+    remove(trace_file);
+}
+
+void reserve_test(){
+    const char* hints_path = "reserve_hints.bin";
+    {
+        context ecs_ctx;
+        ecs_ctx.reserve(5000);
+        ecs_ctx.reserve<health>(5000);
+        for (int32_t i = 0; i < 8000; ++i){
+            ecs_ctx.entity_admin.create_entity()->add_component<health>(i, 100).add_component<velocity>(1.0f, 0.0f, 0.0f);
+        }
+        ecs_ctx.save_reserve_hints(hints_path);
+    }
+
+    // the next run starts with the capacity of the last one
+    context ecs_ctx;
+    bool loaded = ecs_ctx.load_reserve_hints(hints_path);
+    ecs_ctx.entity_admin.create_entity()->add_component<health>(0, 100).add_component<velocity>(1.0f, 0.0f, 0.0f);
+    memory_pool_type* health_pool = ecs_ctx.entity_admin.get_component_pool((component_id)typeid(health).hash_code());
+    memory_pool_type* velocity_pool = ecs_ctx.entity_admin.get_component_pool((component_id)typeid(velocity).hash_code());
+    printf("reserve hints loaded %d, health pool cells %u, velocity pool cells %u\n",
+        loaded, health_pool->total_cell_count(), velocity_pool->total_cell_count());
+    remove(hints_path);
+}
+
+void memory_resource_test(){
+    // a short-lived lookahead context on an arena, the arena is released in one go
+    utility::monotonic_buffer_resource arena(256 * 1024);
+    uint32_t moving = 0;
+    {
+        context lookahead(&arena);
+        group* gp = lookahead.entity_admin.get_group<all_of<health, velocity>>();
+        for (int32_t i = 0; i < 5000; ++i){
+            entity* en = lookahead.entity_admin.create_entity();
+            en->add_component<health>(i, 100);
+            if (i % 2 == 0){
+                en->add_component<velocity>(1.0f, 0.0f, 0.0f);
+            }
+        }
+        moving = gp->entity_count();
+    }
+    std::size_t arena_size = arena.chunk_size_total();
+    arena.release();
+    printf("memory resource arena moving %u, arena used %d, released %d\n",
+        moving, arena_size > 0, arena.chunk_size_total() == 0);
+}
+
+/** collects the low health candidates into the frame memory each tick */
+class low_health_system : public system
+{
+protected:
+    context&    ctx_;
+    group*      group_;
+public:
+    uint32_t    candidate_count;
+
+    low_health_system(context& ctx)
+        : ctx_(ctx)
+        , group_(ctx.entity_admin.get_group<all_of<health>>())
+        , candidate_count(0){
+    }
+
+    virtual void initialize() override{}
+    virtual void fixed_update(time_delta /*dt*/) override{}
+    virtual void update(time_delta /*dt*/) override{
+        entity** candidates = ctx_.frame_alloc<entity*>(group_->entity_count());
+        uint32_t count = 0;
+        for (auto en : group_->entities()){
+            if (en->get_component<health>()->hp < 50){
+                candidates[count++] = en;
+            }
+        }
+        candidate_count = count;
+    }
+};
+
+void frame_allocator_test(){
+    context ecs_ctx;
+    for (int32_t i = 0; i < 1000; ++i){
+        ecs_ctx.entity_admin.create_entity()->add_component<health>(i % 100, 100);
+    }
+
+    bool unmanaged_rejected = false;
+    try{
+        ecs_ctx.frame_alloc<int32_t>(16);
+    }
+    catch (const std::logic_error&){
+        unmanaged_rejected = true;
+    }
+
+    system_manager systems(ecs_ctx);
+    systems.add<low_health_system>(ecs_ctx);
+    systems.update(0.1);
+    std::size_t capacity = ecs_ctx.frame().arena().capacity();
+    for (int32_t i = 0; i < 100; ++i){
+        systems.update(0.1);
+    }
+
+    // the systems driven one by one, the frame is ended explicitly
+    for (int32_t i = 0; i < 100; ++i){
+        systems.update<low_health_system>(0.1);
+        systems.end_frame();
+    }
+
+    // the workers get their own arenas
+    std::vector<std::thread> workers;
+    for (int32_t i = 0; i < 2; ++i){
+        workers.push_back(std::thread([&ecs_ctx](){
+            int32_t* buffer = ecs_ctx.frame_alloc<int32_t>(1024);
+            buffer[1023] = 1;
+        }));
+    }
+    for (auto& worker : workers){
+        worker.join();
+    }
+    // alternating between two allocators stays on the thread cache
+    frame_allocator other_frame;
+    for (int32_t i = 0; i < 10; ++i){
+        other_frame.alloc<int32_t>(4);
+        ecs_ctx.frame().alloc<int32_t>(4);
+    }
+    printf("frame allocator unmanaged rejected %d, candidates %u, high water %u, capacity stable %d, arenas %u %u\n",
+        unmanaged_rejected, systems.system<low_health_system>()->candidate_count, (uint32_t)ecs_ctx.frame().arena().high_water(),
+        capacity == ecs_ctx.frame().arena().capacity(), ecs_ctx.frame().arena_count(), other_frame.arena_count());
+}
+
+void read_snapshot_test(){
+    context ecs_ctx;
+    std::vector<entity*> entitys;
+    for (int32_t i = 0; i < 1000; ++i){
+        entity* en = ecs_ctx.entity_admin.create_entity();
+        en->add_component<health>(0, 0);
+        entitys.push_back(en);
+    }
+
+    read_snapshot_publisher<health> healths(ecs_ctx.entity_admin, 64);
+
+    // the reader sees the whole world at one tick, never a half written tick
+    std::atomic<bool> done(false);
+    std::atomic<int32_t> torn_count(0);
+    std::atomic<int32_t> read_count(0);
+    std::thread reader([&](){
+        while (!done.load()){
+            read_snapshot<health>::ptr snap = healths.acquire();
+            int32_t tick = (int32_t)snap->tick() - 1;
+            snap->for_each([&](int64_t /*entity_id*/, const health& hp){
+                if (hp.hp != tick || hp.max_hp != tick){
+                    ++torn_count;
+                }
+            });
+            ++read_count;
+        }
+    });
+
+    for (int32_t tick = 1; tick <= 200; ++tick){
+        for (auto en : entitys){
+            en->patch_component<health>([tick](health& hp){ hp.hp = tick; hp.max_hp = tick; });
+        }
+        healths.publish();
+    }
+    done = true;
+    reader.join();
+
+    // only the written chunk is copied
+    read_snapshot<health>::ptr before = healths.acquire();
+    entitys[0]->patch_component<health>([](health& hp){ hp.hp = -1; });
+    read_snapshot<health>::ptr after = healths.publish();
+    int32_t shared_count = 0;
+    for (std::size_t i = 0; i < after->chunks().size(); ++i){
+        shared_count += before->chunks()[i] == after->chunks()[i] ? 1 : 0;
+    }
+
+    entitys[1]->destory();
+    entitys[2]->remove_component<health>();
+    uint32_t row_count = healths.publish()->size();
+
+    // a disabled entity is dropped from the rows, and comes back with the value written meanwhile
+    entitys[3]->set_enabled(false);
+    entitys[3]->patch_component<health>([](health& hp){ hp.hp = 1000; });
+    uint32_t disabled_row_count = healths.publish()->size();
+    entitys[3]->set_enabled(true);
+    int32_t enabled_hp = 0;
+    healths.publish()->for_each([&](int64_t entity_id, const health& hp){
+        if (entity_id == entitys[3]->id()){
+            enabled_hp = hp.hp;
+        }
+    });
+    printf("read snapshot torn %d, reads > 0 %d, chunks %u, shared %d, pinned hp %d, rows %u, disabled rows %u, enabled hp %d\n",
+        torn_count.load(), read_count.load() > 0, (uint32_t)after->chunks().size(), shared_count,
+        before->chunks()[0]->rows[0].value.hp, row_count, disabled_row_count, enabled_hp);
+}
+
+typedef static_world<health, velocity, stunned> static_world_type;
+
+class static_move_system
+{
+public:
+    int64_t moved_count;
+
+    static_move_system() : moved_count(0){}
+
+    void initialize(static_world_type& /*world*/){
+    }
+
+    void update(static_world_type& world, time_delta dt){
+        world.view<velocity>().without<stunned>().each([&](static_world_type::entity /*en*/, velocity& vel){
+            vel.x += (float)dt;
+            ++moved_count;
+        });
+    }
+
+    void fixed_update(static_world_type& /*world*/, time_delta /*dt*/){
+    }
+};
+
+void static_world_test(){
+    static_world_type world;
+    static_system_manager<static_world_type, static_move_system> systems;
+    systems.initialize(world);
+
+    for (int32_t i = 0; i < 10000; ++i){
+        static_world_type::entity en = world.create_entity();
+        en.add_component<velocity>(0.0f, 0.0f, (float)i);
+        if (i % 2 == 0){
+            en.add_component<health>(i, 100);
+        }
+        if (i % 10 == 0){
+            en.add_component<stunned>();
+        }
+    }
+
+    static_world_type::entity first = world.entity_at(0);
+    first.destory();
+    static_world_type::entity reused = world.create_entity();
+    reused.add_component<velocity>(0.0f, 0.0f, 0.0f);
+    bool duplicate_rejected = false;
+    try{
+        reused.add_component<velocity>(1.0f, 1.0f, 1.0f);
+    }
+    catch (const std::runtime_error&){
+        duplicate_rejected = true;
+    }
+    printf("static world duplicate add rejected %d\n", duplicate_rejected);
+
+    // the stale handle must not reach the entity that reused the index
+    bool stale_rejected = false;
+    try{
+        first.add_component<stunned>();
+    }
+    catch (const std::runtime_error&){
+        stale_rejected = true;
+    }
+    printf("static world stale add rejected %d, stale get null %d, reused stunned %d\n",
+        stale_rejected, first.get_component<velocity>() == nullptr, reused.has_component<stunned>());
+
+    auto bench = utility::profile::run_benchmark("static world update", 100, [&](){
+        systems.update(world, 1.0);
+    });
+    bench.print();
+    printf("static world entitys %u, health&velocity %u, moved %lld, stale handle valid %d, reused index %u\n",
+        world.entity_count(), world.view<health, velocity>().entity_count(),
+        (long long)systems.system<static_move_system>().moved_count, first.valid(), reused.index());
+}
+
+void shared_component_test(){
+    context ecs_ctx;
+    mesh_desc desc[4];
+    memset(desc, 0, sizeof(desc));
+    for (int32_t i = 0; i < 4; ++i){
+        sprintf(desc[i].path, "mesh/tree_%d.mesh", i);
+        desc[i].lod = i;
+    }
+
+    for (int32_t i = 0; i < 10000; ++i){
+        ecs_ctx.entity_admin.create_entity()
+            ->add_component<health>(i, 100)
+            .add_shared_component<mesh_desc>(desc[i % 4]);
+    }
+
+    // switch some entitys to another mesh, and drop some
+    for (int32_t i = 1; i <= 1000; ++i){
+        ecs_ctx.entity_admin.get_entity(i)->replace_shared_component<mesh_desc>(desc[0]);
+    }
+    for (int32_t i = 1001; i <= 2000; ++i){
+        ecs_ctx.entity_admin.get_entity(i)->destory();
+    }
+
+    // batch by value
+    uint32_t lod_counts[4] = { 0 };
+    ecs_ctx.entity_admin.for_each_shared<mesh_desc>([&](const mesh_desc& mesh, const std::unordered_set<entity*>& ens){
+        lod_counts[mesh.lod] = (uint32_t)ens.size();
+    });
+    entity* en = ecs_ctx.entity_admin.get_entity(3000);
+    printf("shared mesh values %u, entitys per lod %u %u %u %u, entity 3000 shared %d, same value %d\n",
+        (uint32_t)ecs_ctx.entity_admin.shared_value_count<mesh_desc>(), lod_counts[0], lod_counts[1], lod_counts[2], lod_counts[3],
+        en->is_shared_component<mesh_desc>(), en->get_component<mesh_desc>() == ecs_ctx.entity_admin.get_entity(3004)->get_component<mesh_desc>());
+}
+
 }
 
 
@@ -165,6 +1312,52 @@ int main()
 
     ecs_cpp::mather_test();
 
+    ecs_cpp::perf_counter_test();
+
+    ecs_cpp::trace_test();
+
+    ecs_cpp::snapshot_test();
+
+    ecs_cpp::replication_test();
+
+    ecs_cpp::journal_test();
+
+    ecs_cpp::pod_component_test();
+
+    ecs_cpp::tag_component_test();
+
+    ecs_cpp::unique_component_test();
+
+    ecs_cpp::shared_component_test();
+
+    ecs_cpp::composite_query_test();
+
+    ecs_cpp::group_population_test();
+
+    ecs_cpp::entity_index_test();
+
+    ecs_cpp::sorted_group_test();
+
+    ecs_cpp::spatial_grid_test();
+
+    ecs_cpp::patch_component_test();
+
+    ecs_cpp::entity_enable_test();
+
+    ecs_cpp::entity_enable_persist_test();
+
+    ecs_cpp::world_clear_test();
+
+    ecs_cpp::reserve_test();
+
+    ecs_cpp::memory_resource_test();
+
+    ecs_cpp::frame_allocator_test();
+
+    ecs_cpp::read_snapshot_test();
+
+    ecs_cpp::static_world_test();
+
     system("pause");
     return 0;
 }
\ No newline at end of file
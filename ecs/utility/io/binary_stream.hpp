@@ -0,0 +1,284 @@
+﻿/**
+ *
+ * binary_stream.hpp
+ *
+ * a simple binary writer/reader, little endian, with varint(LEB128) support
+ */
+
+#ifndef __ydk_utility_io_binary_stream_hpp__
+#define __ydk_utility_io_binary_stream_hpp__
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+
+namespace utility
+{
+namespace io
+{
+    /**
+     * @brief append only binary buffer writer
+     */
+    class binary_writer
+    {
+    public:
+        typedef std::vector<uint8_t> buffer_type;
+
+        binary_writer()
+        {
+        }
+
+        explicit binary_writer(std::size_t reserve_size)
+        {
+            m_buffer.reserve(reserve_size);
+        }
+
+    public:
+        void    write_u8(uint8_t v)
+        {
+            m_buffer.push_back(v);
+        }
+
+        void    write_u32(uint32_t v)
+        {
+            uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+            write_bytes(b, sizeof(b));
+        }
+
+        void    write_u64(uint64_t v)
+        {
+            write_u32((uint32_t)v);
+            write_u32((uint32_t)(v >> 32));
+        }
+
+        /**
+         * @brief unsigned LEB128, 1 byte for values < 128
+         */
+        void    write_varint(uint64_t v)
+        {
+            while( v >= 0x80 )
+            {
+                m_buffer.push_back((uint8_t)(v | 0x80));
+                v >>= 7;
+            }
+            m_buffer.push_back((uint8_t)v);
+        }
+
+        /**
+         * @brief zigzag encoded signed varint, small negative values stay small
+         */
+        void    write_svarint(int64_t v)
+        {
+            write_varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+        }
+
+        void    write_bytes(const void* data, std::size_t size)
+        {
+            if( size > 0 )
+            {
+                const uint8_t* p = static_cast<const uint8_t*>(data);
+                m_buffer.insert(m_buffer.end(), p, p + size);
+            }
+        }
+
+        /**
+         * @brief overwrite a u32 at the offset(eg. a length/checksum placeholder)
+         */
+        void    patch_u32(std::size_t offset, uint32_t v)
+        {
+            if( offset + 4 <= m_buffer.size() )
+            {
+                m_buffer[offset] = (uint8_t)v;
+                m_buffer[offset + 1] = (uint8_t)(v >> 8);
+                m_buffer[offset + 2] = (uint8_t)(v >> 16);
+                m_buffer[offset + 3] = (uint8_t)(v >> 24);
+            }
+        }
+
+        const uint8_t*  data() const
+        {
+            return m_buffer.empty() ? nullptr : &m_buffer[0];
+        }
+
+        std::size_t     size() const
+        {
+            return m_buffer.size();
+        }
+
+        void    clear()
+        {
+            m_buffer.clear();
+        }
+
+        buffer_type&    buffer()
+        {
+            return m_buffer;
+        }
+
+    private:
+        buffer_type     m_buffer;
+    };
+
+    /**
+     * @brief binary reader over a memory block(not owned)
+     * all the read functions return false if there is not enough data, and the reader is marked failed
+     */
+    class binary_reader
+    {
+    public:
+        binary_reader(const void* data, std::size_t size)
+            : m_data(static_cast<const uint8_t*>(data))
+            , m_size(size)
+            , m_pos(0)
+            , m_failed(false)
+        {
+        }
+
+    public:
+        bool    read_u8(uint8_t& v)
+        {
+            if( m_pos >= m_size )
+            {
+                return fail();
+            }
+            v = m_data[m_pos ++];
+            return true;
+        }
+
+        bool    read_u32(uint32_t& v)
+        {
+            if( 4 > m_size - m_pos )
+            {
+                return fail();
+            }
+            const uint8_t* p = m_data + m_pos;
+            v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+            m_pos += 4;
+            return true;
+        }
+
+        bool    read_u64(uint64_t& v)
+        {
+            uint32_t lo = 0, hi = 0;
+            if( 8 > m_size - m_pos || !read_u32(lo) || !read_u32(hi) )
+            {
+                return fail();
+            }
+            v = (uint64_t)lo | ((uint64_t)hi << 32);
+            return true;
+        }
+
+        bool    read_varint(uint64_t& v)
+        {
+            v = 0;
+            for( uint32_t shift = 0; shift < 64; shift += 7 )
+            {
+                if( m_pos >= m_size )
+                {
+                    return fail();
+                }
+                uint8_t b = m_data[m_pos ++];
+                v |= (uint64_t)(b & 0x7f) << shift;
+                if( (b & 0x80) == 0 )
+                {
+                    return true;
+                }
+            }
+            return fail();
+        }
+
+        bool    read_svarint(int64_t& v)
+        {
+            uint64_t u = 0;
+            if( !read_varint(u) )
+            {
+                return false;
+            }
+            v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            return true;
+        }
+
+        bool    read_bytes(void* out, std::size_t size)
+        {
+            if( size > m_size - m_pos )
+            {
+                return fail();
+            }
+            if( size > 0 )
+            {
+                memcpy(out, m_data + m_pos, size);
+            }
+            m_pos += size;
+            return true;
+        }
+
+        /**
+         * @brief get the pointer of the next size bytes without copy, and skip them
+         */
+        const uint8_t*  read_view(std::size_t size)
+        {
+            if( size > m_size - m_pos )
+            {
+                fail();
+                return nullptr;
+            }
+            const uint8_t* p = m_data + m_pos;
+            m_pos += size;
+            return p;
+        }
+
+        bool    skip(std::size_t size)
+        {
+            return read_view(size) != nullptr || size == 0;
+        }
+
+        std::size_t     position() const
+        {
+            return m_pos;
+        }
+
+        std::size_t     remain() const
+        {
+            return m_size - m_pos;
+        }
+
+        /**
+         * @brief whether a size read from the stream(eg. a u64 length prefix) fits in the remaining data,
+         * check it before casting the size to std::size_t
+         */
+        bool    fits(uint64_t size) const
+        {
+            return size <= (uint64_t)remain();
+        }
+
+        bool    eof() const
+        {
+            return m_pos >= m_size;
+        }
+
+        /**
+         * @brief whether any read has failed
+         */
+        bool    failed() const
+        {
+            return m_failed;
+        }
+
+    private:
+        bool    fail()
+        {
+            m_failed = true;
+            return false;
+        }
+
+    private:
+        const uint8_t*  m_data;
+        std::size_t     m_size;
+        std::size_t     m_pos;
+        bool            m_failed;
+    };
+}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,177 @@
+﻿/**
+ *
+ * mapped_file.hpp
+ *
+ * read only memory mapped file(mmap on posix, file mapping on windows)
+ */
+
+#ifndef __ydk_utility_io_mapped_file_hpp__
+#define __ydk_utility_io_mapped_file_hpp__
+
+#include <cstdint>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace utility
+{
+namespace io
+{
+    class mapped_file
+    {
+    public:
+        mapped_file()
+            : m_data(nullptr)
+            , m_size(0)
+#if defined(_WIN32)
+            , m_file(INVALID_HANDLE_VALUE)
+            , m_mapping(NULL)
+#endif
+        {
+        }
+
+        ~mapped_file()
+        {
+            close();
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator = (const mapped_file&) = delete;
+
+    public:
+        /**
+         * @brief map the whole file read only
+         * @return false if the file can't be opened or mapped
+         */
+        bool    open(const std::string& path)
+        {
+            close();
+
+#if defined(_WIN32)
+            m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if( m_file == INVALID_HANDLE_VALUE )
+            {
+                return false;
+            }
+
+            LARGE_INTEGER file_size;
+            if( !GetFileSizeEx(m_file, &file_size) )
+            {
+                close();
+                return false;
+            }
+            m_size = (std::size_t)file_size.QuadPart;
+            if( m_size == 0 )
+            {
+                return true;
+            }
+
+            m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if( m_mapping == NULL )
+            {
+                close();
+                return false;
+            }
+
+            m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+            if( !m_data )
+            {
+                close();
+                return false;
+            }
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if( fd < 0 )
+            {
+                return false;
+            }
+
+            struct stat st;
+            if( fstat(fd, &st) != 0 )
+            {
+                ::close(fd);
+                return false;
+            }
+            m_size = (std::size_t)st.st_size;
+            if( m_size == 0 )
+            {
+                ::close(fd);
+                return true;
+            }
+
+            void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if( p == MAP_FAILED )
+            {
+                m_size = 0;
+                return false;
+            }
+            madvise(p, m_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const uint8_t*>(p);
+#endif
+            return true;
+        }
+
+        void    close()
+        {
+#if defined(_WIN32)
+            if( m_data )
+            {
+                UnmapViewOfFile(m_data);
+            }
+            if( m_mapping != NULL )
+            {
+                CloseHandle(m_mapping);
+                m_mapping = NULL;
+            }
+            if( m_file != INVALID_HANDLE_VALUE )
+            {
+                CloseHandle(m_file);
+                m_file = INVALID_HANDLE_VALUE;
+            }
+#else
+            if( m_data )
+            {
+                munmap(const_cast<uint8_t*>(m_data), m_size);
+            }
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        const uint8_t*  data() const
+        {
+            return m_data;
+        }
+
+        std::size_t     size() const
+        {
+            return m_size;
+        }
+
+    private:
+        const uint8_t*  m_data;
+        std::size_t     m_size;
+#if defined(_WIN32)
+        HANDLE          m_file;
+        HANDLE          m_mapping;
+#endif
+    };
+}
+}
+
+#endif
\ No newline at end of file
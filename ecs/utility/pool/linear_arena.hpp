@@ -0,0 +1,183 @@
+﻿/**
+ *
+ * linear_arena.hpp
+ *
+ * a bump pointer arena that is rewound as a whole, for the transient per tick buffers
+ * the chunks are kept over the resets, and merged into one chunk once the usage is known,
+ * so the steady state allocates nothing from the upstream
+ */
+
+#ifndef __ydk_utility_pool_linear_arena_hpp__
+#define __ydk_utility_pool_linear_arena_hpp__
+
+#include <utility/pool/memory_resource.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace utility
+{
+    /** 
+     * @brief 
+     * linear arena, deallocate does nothing and reset() rewinds all the allocations
+     * not thread safe, use one arena per thread
+     */
+    class linear_arena : public memory_resource
+    {
+    public:
+        /** 
+         * @param initial_size:     the size of the first chunk
+         * @param upstream:         where the chunks come from
+         */
+        explicit linear_arena(std::size_t initial_size = 64 * 1024, memory_resource* upstream = nullptr)
+            : m_upstream(upstream ? upstream : default_memory_resource())
+            , m_initial_size(initial_size > 0 ? initial_size : 1024)
+            , m_current(0)
+            , m_offset(0)
+            , m_used(0)
+            , m_high_water(0)
+        {
+        }
+
+        virtual ~linear_arena()
+        {
+            free_chunks();
+        }
+
+        linear_arena(const linear_arena&) = delete;
+        linear_arena& operator = (const linear_arena&) = delete;
+
+    public:
+        /** 
+         * @brief rewind all the allocations, the memory allocated from the arena is invalid after it
+         * the chunks of a spilled tick are merged into one chunk large enough for it
+         */
+        void    reset()
+        {
+            if( m_chunks.size() > 1 )
+            {
+                std::size_t total = 0;
+                for( auto& chunk : m_chunks )
+                {
+                    total += chunk.second;
+                }
+                free_chunks();
+                add_chunk(total);
+            }
+            m_current = 0;
+            m_offset = 0;
+            m_used = 0;
+        }
+
+        /** 
+         * @brief the bytes allocated since the last reset
+         */
+        std::size_t used() const
+        {
+            return m_used;
+        }
+
+        /** 
+         * @brief the max bytes allocated between two resets
+         */
+        std::size_t high_water() const
+        {
+            return m_high_water;
+        }
+
+        /** 
+         * @brief the total size of the chunks
+         */
+        std::size_t capacity() const
+        {
+            std::size_t total = 0;
+            for( auto& chunk : m_chunks )
+            {
+                total += chunk.second;
+            }
+            return total;
+        }
+
+    protected:
+        virtual void*   do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            while( true )
+            {
+                if( m_current < m_chunks.size() )
+                {
+                    char* base = m_chunks[m_current].first;
+                    std::size_t offset = align_up(base, m_offset, alignment);
+                    if( offset + bytes <= m_chunks[m_current].second )
+                    {
+                        m_offset = offset + bytes;
+                        m_used += bytes;
+                        if( m_used > m_high_water )
+                        {
+                            m_high_water = m_used;
+                        }
+                        return base + offset;
+                    }
+
+                    // the rest of the chunk is skipped
+                    if( m_current + 1 < m_chunks.size() )
+                    {
+                        ++ m_current;
+                        m_offset = 0;
+                        continue;
+                    }
+                }
+
+                std::size_t size = m_chunks.empty() ? m_initial_size : m_chunks.back().second * 2;
+                while( size < bytes + alignment )
+                {
+                    size *= 2;
+                }
+                add_chunk(size);
+                m_current = m_chunks.size() - 1;
+                m_offset = 0;
+            }
+        }
+
+        virtual void    do_deallocate(void* /*p*/, std::size_t /*bytes*/, std::size_t /*alignment*/) override
+        {
+        }
+
+    private:
+        static std::size_t align_up(const char* base, std::size_t offset, std::size_t alignment)
+        {
+            std::size_t mis = (std::size_t)((uintptr_t)(base + offset) & (alignment - 1));
+            return mis ? offset + alignment - mis : offset;
+        }
+
+        void    add_chunk(std::size_t size)
+        {
+            m_chunks.push_back(std::make_pair((char*)m_upstream->allocate(size), size));
+        }
+
+        void    free_chunks()
+        {
+            for( auto& chunk : m_chunks )
+            {
+                m_upstream->deallocate(chunk.first, chunk.second);
+            }
+            m_chunks.clear();
+        }
+
+    private:
+
+        memory_resource*    m_upstream;         // the source of the chunks
+
+        std::size_t         m_initial_size;
+
+        std::vector<std::pair<char*, std::size_t>> m_chunks;
+
+        std::size_t         m_current;          // the chunk in use
+
+        std::size_t         m_offset;           // the free offset of the chunk in use
+
+        std::size_t         m_used;
+
+        std::size_t         m_high_water;
+    };
+}
+
+#endif
\ No newline at end of file
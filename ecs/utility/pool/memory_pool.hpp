@@ -15,32 +15,51 @@
 #include <list>
 #include <vector>
 #include <mutex>
+#include <type_traits>
+#include <utility/pool/memory_resource.hpp>
 
 namespace utility
 {
+    /** 
+     * @brief how the pool inflates when there is no free cell
+     */
+    enum pool_grow_policy
+    {
+        pool_grow_fixed     = 0,    // a slab of grow_cell_count cells
+        pool_grow_geometric = 1,    // double the total cells, at least grow_cell_count
+    };
+
     /** 
      * @brief 
      * memory pool, try to decrease the cost that allocate memory and free memory
      * try to reuse the object memory as far as possible
+     * the cells are carved from slabs, one allocation from the memory resource per inflate
      */
     template<class Mutex>
     class memory_pool
     {
     public:
 
-        typedef uint32_t            size_type;
-        typedef void*               pointer;
-        typedef std::list<pointer>  cell_queue_type;
+        typedef uint32_t                size_type;
+        typedef void*                   pointer;
+        typedef std::vector<pointer>    cell_array_type;
 
         /** 
          * @brief
          * @param cell_size:            each cell's meory size
          * @param initial_cell_count:   initial cell count
          * @param grow_cell_count:      the memory pool infate speed
+         * @param policy:               the grow policy
+         * @param resource:             where the slabs come from, the global heap if null
          */
-        memory_pool(size_type cell_size, size_type initial_cell_count, size_type grow_cell_count = 1)
-            :m_cell_size(cell_size)
-            ,m_grow_cell_count(grow_cell_count)
+        memory_pool(size_type cell_size, size_type initial_cell_count, size_type grow_cell_count = 1,
+            pool_grow_policy policy = pool_grow_fixed, memory_resource* resource = nullptr)
+            :m_resource(resource ? resource : default_memory_resource())
+            ,m_cell_size(cell_size)
+            ,m_grow_cell_count(grow_cell_count > 0 ? grow_cell_count : 1)
+            ,m_grow_policy(policy)
+            ,m_total_cell_count(0)
+            ,m_high_water(0)
         {
             inflate(initial_cell_count);
         }
@@ -57,13 +76,13 @@ namespace utility
         {
             std::lock_guard<Mutex> locker(m_mtx);
 
-            auto iter = m_total_cells.begin();
-            for( iter; iter != m_total_cells.end(); ++ iter )
+            for( auto& slab : m_slabs )
             {
-                free(*iter);
+                m_resource->deallocate(slab.first, slab.second);
             }
-            m_total_cells.clear();
+            m_slabs.clear();
             m_free_cells.clear();
+            m_total_cell_count = 0;
         }
 
         /** 
@@ -75,11 +94,17 @@ namespace utility
 
             if( m_free_cells.empty())
             {
-                inflate(m_grow_cell_count);
+                inflate(next_grow_count());
             }
 
-            pointer ret = m_free_cells.front();
-            m_free_cells.pop_front();
+            pointer ret = m_free_cells.back();
+            m_free_cells.pop_back();
+
+            size_type used = m_total_cell_count - (size_type)m_free_cells.size();
+            if( used > m_high_water )
+            {
+                m_high_water = used;
+            }
 
             return ret;
         }
@@ -94,6 +119,40 @@ namespace utility
             m_free_cells.push_back(p);
         }
 
+        /** 
+         * @brief make sure there are at least count cells in total, in one slab
+         */
+        void    reserve(size_type count)
+        {
+            std::lock_guard<Mutex> locker(m_mtx);
+
+            if( count > m_total_cell_count )
+            {
+                inflate(count - m_total_cell_count);
+            }
+        }
+
+        /** 
+         * @brief set the grow policy of the later inflates
+         */
+        void    set_grow_policy(pool_grow_policy policy, size_type grow_cell_count)
+        {
+            std::lock_guard<Mutex> locker(m_mtx);
+
+            m_grow_policy = policy;
+            m_grow_cell_count = grow_cell_count > 0 ? grow_cell_count : 1;
+        }
+
+        /** 
+         * @brief the max count of the cells in use at the same time
+         */
+        inline  size_type high_water()
+        {
+            std::lock_guard<Mutex> locker(m_mtx);
+
+            return m_high_water;
+        }
+
         /** 
          * @brief get current free cell count
          */
@@ -121,7 +180,7 @@ namespace utility
         {
             std::lock_guard<Mutex> locker(m_mtx);
 
-            return m_total_cells.size();
+            return m_total_cell_count;
         }
 
         /** 
@@ -131,43 +190,77 @@ namespace utility
         {
             std::lock_guard<Mutex> locker(m_mtx);
 
-            return m_total_cells.size() * m_cell_size;
+            return m_total_cell_count * m_cell_size;
         }
 
     private:
 
+        size_type   next_grow_count() const
+        {
+            if( m_grow_policy == pool_grow_geometric && m_total_cell_count > m_grow_cell_count )
+            {
+                return m_total_cell_count;
+            }
+            return m_grow_cell_count;
+        }
+
         /** 
          * inflate the pool size
          */
         void    inflate(size_type count)
         {
-            for( size_type i = 0; i < count; ++ i )
+            if( count == 0 )
+            {
+                return;
+            }
+
+            std::size_t slab_size = (std::size_t)m_cell_size * count;
+            char* slab = (char*)m_resource->allocate(slab_size);
+            m_slabs.push_back(std::make_pair((pointer)slab, slab_size));
+            m_free_cells.reserve(m_free_cells.size() + count);
+
+            // the first cell of the slab is allocated first
+            for( size_type i = count; i > 0; -- i )
             {
-                pointer p = malloc(m_cell_size);
-                m_free_cells.push_back(p);
-                m_total_cells.push_back(p);
+                m_free_cells.push_back(slab + (std::size_t)m_cell_size * (i - 1));
             }
+            m_total_cell_count += count;
         }
 
     private:
 
+        memory_resource* m_resource;        // 内存来源
+
         size_type       m_cell_size;        // 每个单元的内存大小
         
         size_type       m_grow_cell_count;  // 内存池内存膨胀的速度（增加的单元数)
 
-        cell_queue_type m_free_cells;       // 空闲的单元列表
+        pool_grow_policy m_grow_policy;     // 膨胀策略
+
+        size_type       m_total_cell_count; // 总单元数
+
+        size_type       m_high_water;       // 同时使用的最大单元数
 
-        cell_queue_type m_total_cells;      // 总单元列表
+        cell_array_type m_free_cells;       // 空闲的单元列表
+
+        std::vector<std::pair<pointer, std::size_t>> m_slabs;  // 分配的内存块列表<地址, 大小>
 
         Mutex           m_mtx;              // 互斥量 
     };
 
+    /** 
+     * memory pool of T, the reclaimed cell is destructed
+     * the destructor only runs for the non trivially destructible types
+     */
     template<class T, class Mutex>
     class memory_pool_ex : public memory_pool<Mutex>
     {
     public:
-        memory_pool_ex(size_type initial_cell_count, size_type grow_cell_count = 1)
-            : memory_pool(sizeof(T), initial_cell_count, grow_cell_count)
+        typedef typename memory_pool<Mutex>::size_type  size_type;
+        typedef typename memory_pool<Mutex>::pointer    pointer;
+
+        memory_pool_ex(size_type initial_cell_count, size_type grow_cell_count = 1, memory_resource* resource = nullptr)
+            : memory_pool<Mutex>(sizeof(T), initial_cell_count, grow_cell_count, pool_grow_fixed, resource)
         {
         }
         virtual ~memory_pool_ex(){
@@ -178,10 +271,20 @@ namespace utility
         {
             T* p_t = static_cast<T*>(p);
             if (p_t){
-                p_t->~T();
+                destruct(p_t, std::integral_constant<bool, std::is_trivially_destructible<T>::value>());
             }
             memory_pool<Mutex>::reclaim(p);
         }
+
+    private:
+        static void destruct(T* p, std::false_type)
+        {
+            p->~T();
+        }
+
+        static void destruct(T* /*p*/, std::true_type)
+        {
+        }
     };
 
 
@@ -0,0 +1,260 @@
+﻿/**
+ *
+ * memory_resource.hpp
+ *
+ * a polymorphic memory resource and the allocator over it, the shape of std::pmr
+ * (which is not available before c++17), the containers and the pools allocate
+ * from the resource they are given, the global heap by default
+ */
+
+#ifndef __ydk_utility_pool_memory_resource_hpp__
+#define __ydk_utility_pool_memory_resource_hpp__
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+namespace utility
+{
+    /** 
+     * @brief the memory resource interface
+     */
+    class memory_resource
+    {
+    public:
+        static const std::size_t max_align = sizeof(void*) * 2;
+
+        virtual ~memory_resource()
+        {
+        }
+
+        void*   allocate(std::size_t bytes, std::size_t alignment = max_align)
+        {
+            return do_allocate(bytes, alignment);
+        }
+
+        void    deallocate(void* p, std::size_t bytes, std::size_t alignment = max_align)
+        {
+            do_deallocate(p, bytes, alignment);
+        }
+
+    protected:
+        virtual void*   do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+
+        virtual void    do_deallocate(void* p, std::size_t bytes, std::size_t alignment) = 0;
+    };
+
+    /** 
+     * @brief the global heap, the alignment is at most memory_resource::max_align
+     */
+    class new_delete_resource : public memory_resource
+    {
+    public:
+        static new_delete_resource* instance()
+        {
+            static new_delete_resource resource;
+            return &resource;
+        }
+
+    protected:
+        /** ::operator new aligns to max_align, the larger alignments are not supported */
+        virtual void*   do_allocate(std::size_t bytes, std::size_t /*alignment*/) override
+        {
+            return ::operator new(bytes);
+        }
+
+        virtual void    do_deallocate(void* p, std::size_t /*bytes*/, std::size_t /*alignment*/) override
+        {
+            ::operator delete(p);
+        }
+    };
+
+    /** 
+     * @brief the resource used when none is given
+     */
+    inline memory_resource* default_memory_resource()
+    {
+        return new_delete_resource::instance();
+    }
+
+    /** 
+     * @brief
+     * monotonic arena, the memory is carved from the chunks of the upstream resource,
+     * deallocate does nothing, and all the memory is freed at once by release() or the destructor
+     * for the short-lived contexts(lookahead, prediction), the arena must outlive the context
+     */
+    class monotonic_buffer_resource : public memory_resource
+    {
+    public:
+        /** 
+         * @param initial_size:     the size of the first chunk, the next chunks double
+         * @param upstream:         where the chunks come from
+         */
+        explicit monotonic_buffer_resource(std::size_t initial_size = 64 * 1024, memory_resource* upstream = nullptr)
+            : m_upstream(upstream ? upstream : default_memory_resource())
+            , m_chunks(nullptr)
+            , m_current(nullptr)
+            , m_remain(0)
+            , m_next_size(initial_size > sizeof(chunk_t) ? initial_size : 1024)
+            , m_chunk_size_total(0)
+        {
+        }
+
+        virtual ~monotonic_buffer_resource()
+        {
+            release();
+        }
+
+        monotonic_buffer_resource(const monotonic_buffer_resource&) = delete;
+        monotonic_buffer_resource& operator = (const monotonic_buffer_resource&) = delete;
+
+    public:
+        /** 
+         * @brief free all the chunks, the memory allocated from the arena is invalid after it
+         */
+        void    release()
+        {
+            while( m_chunks )
+            {
+                chunk_t* next = m_chunks->next;
+                m_upstream->deallocate(m_chunks, m_chunks->size);
+                m_chunks = next;
+            }
+            m_current = nullptr;
+            m_remain = 0;
+            m_chunk_size_total = 0;
+        }
+
+        /** 
+         * @brief the total size of the chunks taken from the upstream
+         */
+        std::size_t chunk_size_total() const
+        {
+            return m_chunk_size_total;
+        }
+
+    protected:
+        virtual void*   do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            std::size_t padding = align_padding(m_current, alignment);
+            if( !m_current || padding + bytes > m_remain )
+            {
+                new_chunk(bytes + alignment);
+                padding = align_padding(m_current, alignment);
+            }
+
+            char* p = m_current + padding;
+            m_current = p + bytes;
+            m_remain -= padding + bytes;
+            return p;
+        }
+
+        virtual void    do_deallocate(void* /*p*/, std::size_t /*bytes*/, std::size_t /*alignment*/) override
+        {
+        }
+
+    private:
+        struct chunk_t
+        {
+            chunk_t*    next;
+            std::size_t size;
+        };
+
+        static std::size_t align_padding(const char* p, std::size_t alignment)
+        {
+            std::size_t mis = (std::size_t)(uintptr_t)p & (alignment - 1);
+            return mis ? alignment - mis : 0;
+        }
+
+        void    new_chunk(std::size_t min_size)
+        {
+            std::size_t size = m_next_size;
+            while( size < min_size + sizeof(chunk_t) )
+            {
+                size *= 2;
+            }
+            m_next_size = size * 2;
+
+            chunk_t* chunk = static_cast<chunk_t*>(m_upstream->allocate(size));
+            chunk->next = m_chunks;
+            chunk->size = size;
+            m_chunks = chunk;
+            m_chunk_size_total += size;
+
+            m_current = reinterpret_cast<char*>(chunk) + sizeof(chunk_t);
+            m_remain = size - sizeof(chunk_t);
+        }
+
+    private:
+
+        memory_resource*    m_upstream;         // the source of the chunks
+
+        chunk_t*            m_chunks;           // the chunk list, the newest first
+
+        char*               m_current;          // the free space of the newest chunk
+
+        std::size_t         m_remain;
+
+        std::size_t         m_next_size;        // the size of the next chunk
+
+        std::size_t         m_chunk_size_total;
+    };
+
+    /** 
+     * @brief the std allocator over a memory resource, for the containers
+     */
+    template<typename T>
+    class resource_allocator
+    {
+    public:
+        typedef T value_type;
+
+        resource_allocator()
+            : m_resource(default_memory_resource())
+        {
+        }
+
+        resource_allocator(memory_resource* resource)
+            : m_resource(resource ? resource : default_memory_resource())
+        {
+        }
+
+        template<typename U>
+        resource_allocator(const resource_allocator<U>& other)
+            : m_resource(other.resource())
+        {
+        }
+
+        T*      allocate(std::size_t n)
+        {
+            return static_cast<T*>(m_resource->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void    deallocate(T* p, std::size_t n)
+        {
+            m_resource->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        memory_resource*    resource() const
+        {
+            return m_resource;
+        }
+
+    private:
+        memory_resource*    m_resource;
+    };
+
+    template<typename T, typename U>
+    inline bool operator == (const resource_allocator<T>& a, const resource_allocator<U>& b)
+    {
+        return a.resource() == b.resource();
+    }
+
+    template<typename T, typename U>
+    inline bool operator != (const resource_allocator<T>& a, const resource_allocator<U>& b)
+    {
+        return a.resource() != b.resource();
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+﻿/**
+ *
+ * benchmark.hpp
+ *
+ * a simple benchmark case runner, sample the wall time and the hardware counters
+ */
+
+#ifndef __ydk_utility_profile_benchmark_hpp__
+#define __ydk_utility_profile_benchmark_hpp__
+
+#include <utility/profile/perf_counter.hpp>
+#include <cstdio>
+#include <string>
+#include <functional>
+
+namespace utility
+{
+namespace profile
+{
+    /**
+     * @brief the result of a benchmark case
+     */
+    struct benchmark_result
+    {
+        std::string         name;
+        uint64_t            iterations;
+        perf_counter_sample total;          // the sum of all iterations
+
+        benchmark_result()
+            : iterations(0)
+        {
+        }
+
+        /**
+         * @brief print the result, counters are reported per iteration
+         */
+        void    print(FILE* out = stdout) const
+        {
+            double n = iterations > 0 ? (double)iterations : 1.0;
+            fprintf(out, "[%s] iterations: %llu, wall: %.1f ns/iter",
+                name.c_str(), (unsigned long long)iterations, total.wall_ns / n);
+
+            static const char* names[pck_count] = {
+                "cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses" };
+            for( int32_t i = 0; i < pck_count; ++ i )
+            {
+                if( total.has((perf_counter_kind)i) )
+                {
+                    fprintf(out, ", %s: %.1f", names[i], total.values[i] / n);
+                }
+            }
+            if( total.has(pck_cycles) && total.has(pck_instructions) )
+            {
+                fprintf(out, ", ipc: %.2f", total.ipc());
+            }
+            fprintf(out, "\n");
+        }
+    };
+
+    /**
+     * @brief run a benchmark case
+     * @param name:         the case name
+     * @param iterations:   the iteration count, the counters cover all iterations
+     * @param func:         the case body, called once per iteration
+     * @param setup:        optional, called once before the sampling
+     */
+    inline benchmark_result run_benchmark(const std::string& name, uint64_t iterations,
+        const std::function<void()>& func, const std::function<void()>& setup = nullptr)
+    {
+        benchmark_result result;
+        result.name = name;
+        result.iterations = iterations;
+
+        if( setup )
+        {
+            setup();
+        }
+
+        perf_counter counter;
+        {
+            scoped_perf_sample s(counter, result.total);
+            for( uint64_t i = 0; i < iterations; ++ i )
+            {
+                func();
+            }
+        }
+        return result;
+    }
+}
+}
+
+#endif
\ No newline at end of file
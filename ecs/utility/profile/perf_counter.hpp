@@ -0,0 +1,298 @@
+﻿/**
+ *
+ * perf_counter.hpp
+ *
+ * hardware performance counter capture(cycles, instructions, branch/cache misses)
+ * use linux perf_event_open when available, otherwise only the wall time is sampled
+ */
+
+#ifndef __ydk_utility_profile_perf_counter_hpp__
+#define __ydk_utility_profile_perf_counter_hpp__
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace utility
+{
+namespace profile
+{
+    /**
+     * @brief the counter kinds, also the index in perf_counter_sample::values
+     */
+    enum perf_counter_kind
+    {
+        pck_cycles = 0,
+        pck_instructions,
+        pck_branch_misses,
+        pck_l1d_read_misses,
+        pck_llc_read_misses,
+        pck_count,
+    };
+
+    /**
+     * @brief one sample(or the sum of samples) of the counters
+     */
+    struct perf_counter_sample
+    {
+        uint64_t    wall_ns;                // wall time in nanoseconds
+        uint64_t    values[pck_count];      // counter values, valid only if (valid_mask & (1 << kind))
+        uint32_t    valid_mask;             // which counters were captured
+
+        perf_counter_sample()
+        {
+            reset();
+        }
+
+        void    reset()
+        {
+            wall_ns = 0;
+            memset(values, 0, sizeof(values));
+            valid_mask = 0;
+        }
+
+        bool    has(perf_counter_kind kind) const
+        {
+            return (valid_mask & (1u << kind)) != 0;
+        }
+
+        perf_counter_sample& operator += (const perf_counter_sample& other)
+        {
+            wall_ns += other.wall_ns;
+            for( int32_t i = 0; i < pck_count; ++ i )
+            {
+                values[i] += other.values[i];
+            }
+            valid_mask |= other.valid_mask;
+            return *this;
+        }
+
+        /**
+         * @brief instructions per cycle, 0 if not captured
+         */
+        double  ipc() const
+        {
+            if( !has(pck_cycles) || !has(pck_instructions) || values[pck_cycles] == 0 )
+            {
+                return 0.0;
+            }
+            return (double)values[pck_instructions] / (double)values[pck_cycles];
+        }
+    };
+
+    /**
+     * @brief
+     * a group of hardware counters of the calling thread
+     * if perf_event_open is unavailable(not linux, no permission, virtualized pmu...),
+     * available() return false, and start/stop only sample the wall time
+     */
+    class perf_counter
+    {
+    public:
+        perf_counter()
+            : m_leader_fd(-1)
+            , m_opened_count(0)
+        {
+            for( int32_t i = 0; i < pck_count; ++ i )
+            {
+                m_fds[i] = -1;
+                m_slot[i] = -1;
+            }
+            open();
+        }
+
+        ~perf_counter()
+        {
+            close();
+        }
+
+        perf_counter(const perf_counter&) = delete;
+        perf_counter& operator = (const perf_counter&) = delete;
+
+    public:
+        /**
+         * @brief whether any hardware counter is opened
+         */
+        bool    available() const
+        {
+            return m_opened_count > 0;
+        }
+
+        /**
+         * @brief reset and start counting
+         */
+        void    start()
+        {
+#if defined(__linux__)
+            if( m_leader_fd >= 0 )
+            {
+                ioctl(m_leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(m_leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#endif
+            m_start_time = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * @brief stop counting and get the sample from the last start()
+         */
+        perf_counter_sample stop()
+        {
+            perf_counter_sample sample;
+            sample.wall_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start_time).count();
+
+#if defined(__linux__)
+            if( m_leader_fd >= 0 )
+            {
+                ioctl(m_leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+                // PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING
+                uint64_t buffer[3 + pck_count];
+                ssize_t n = read(m_leader_fd, buffer, sizeof(buffer));
+                if( n >= (ssize_t)(3 * sizeof(uint64_t)) )
+                {
+                    uint64_t nr = buffer[0];
+                    uint64_t time_enabled = buffer[1];
+                    uint64_t time_running = buffer[2];
+
+                    // the counters may be multiplexed, scale to the enabled time
+                    double scale = 1.0;
+                    if( time_running > 0 && time_running < time_enabled )
+                    {
+                        scale = (double)time_enabled / (double)time_running;
+                    }
+
+                    for( int32_t i = 0; i < pck_count; ++ i )
+                    {
+                        if( m_slot[i] >= 0 && (uint64_t)m_slot[i] < nr )
+                        {
+                            sample.values[i] = (uint64_t)(buffer[3 + m_slot[i]] * scale);
+                            sample.valid_mask |= (1u << i);
+                        }
+                    }
+                }
+            }
+#endif
+            return sample;
+        }
+
+    private:
+        void    open()
+        {
+#if defined(__linux__)
+            open_counter(pck_cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            open_counter(pck_instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            open_counter(pck_branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+            open_counter(pck_l1d_read_misses, PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            open_counter(pck_llc_read_misses, PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+        }
+
+#if defined(__linux__)
+        void    open_counter(perf_counter_kind kind, uint32_t type, uint64_t config)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = (m_leader_fd < 0) ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // this thread, any cpu
+            int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, m_leader_fd, 0);
+            if( fd < 0 )
+            {
+                // the counter is not supported, just skip it
+                return;
+            }
+
+            if( m_leader_fd < 0 )
+            {
+                m_leader_fd = fd;
+            }
+            m_fds[kind] = fd;
+            m_slot[kind] = m_opened_count ++;
+        }
+#endif
+
+        void    close()
+        {
+#if defined(__linux__)
+            for( int32_t i = 0; i < pck_count; ++ i )
+            {
+                if( m_fds[i] >= 0 && m_fds[i] != m_leader_fd )
+                {
+                    ::close(m_fds[i]);
+                }
+                m_fds[i] = -1;
+            }
+            if( m_leader_fd >= 0 )
+            {
+                ::close(m_leader_fd);
+                m_leader_fd = -1;
+            }
+#endif
+            m_opened_count = 0;
+        }
+
+    private:
+
+        int             m_fds[pck_count];       // fd of each counter, -1 if not opened
+
+        int32_t         m_slot[pck_count];      // the value index of each counter in the group read
+
+        int             m_leader_fd;            // the group leader
+
+        int32_t         m_opened_count;         // opened counter count
+
+        std::chrono::steady_clock::time_point   m_start_time;
+    };
+
+    /**
+     * @brief sample the counters in a scope, and accumulate to the result
+     *
+     *  perf_counter_sample iter_sample;
+     *  {
+     *      scoped_perf_sample s(counter, iter_sample);
+     *      for (auto en : gp->entities()){ ... }
+     *  }
+     */
+    class scoped_perf_sample
+    {
+    public:
+        scoped_perf_sample(perf_counter& counter, perf_counter_sample& result)
+            : m_counter(counter)
+            , m_result(result)
+        {
+            m_counter.start();
+        }
+
+        ~scoped_perf_sample()
+        {
+            m_result += m_counter.stop();
+        }
+
+        scoped_perf_sample(const scoped_perf_sample&) = delete;
+        scoped_perf_sample& operator = (const scoped_perf_sample&) = delete;
+
+    private:
+        perf_counter&           m_counter;
+        perf_counter_sample&    m_result;
+    };
+}
+}
+
+#endif
\ No newline at end of file